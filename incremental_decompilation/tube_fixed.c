@@ -0,0 +1,273 @@
+/*
+ * Tube demo — integer-only renderer, checked against tube_rewrite.
+ *
+ * Same frames as tube_rewrite.c, but the pixel loop uses no floating
+ * point at all: sin/cos and atan2 come from CORDIC, the radius from a
+ * Newton-Raphson integer reciprocal square root.  Meant for low-power
+ * cores without (fast) FPUs.
+ *
+ * Run ./tube_rewrite first: this program renders its 25 frames and
+ * compares each against the golden rframe%03d.bmp, reporting how many
+ * pixels differ.  Exits non-zero if a golden frame is missing.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define W     320
+#define H     200
+#define ROWS  160
+
+#define EYE_DIST    160              /* camera distance from cylinder axis */
+#define TEX_SCALE   41               /* texture coordinate multiplier */
+#define ANIM_Q29    12779561         /* 0x1.860052p-6 rad in Q29 (exact) */
+
+#define Q           20               /* fraction bits of the geometry */
+#define PI_Q29      1686629713       /* pi in Q29 */
+#define HALF_PI_Q29 843314857
+#define CORDIC_N    28
+#define CORDIC_K    652032874        /* prod 1/sqrt(1 + 2^-2i) in Q30 */
+
+static uint8_t palette[768];         /* 256 x RGB, 6-bit VGA values */
+static uint8_t texture[65536];       /* 256x256 procedural texture */
+static uint8_t pixbuf[ROWS * W];     /* pixel accumulation buffer */
+static uint8_t vga[W * H];
+
+/* atan(2^-i) in Q29 */
+static const int32_t cordic_atan[CORDIC_N] = {
+	421657428, 248918915, 131521918, 66762579, 33510843, 16771758,
+	8387925, 4194219, 2097141, 1048575, 524288, 262144, 131072, 65536,
+	32768, 16384, 8192, 4096, 2048, 1024, 512, 256, 128, 64, 32, 16, 8, 4
+};
+
+/* ---- Palette and texture: identical to tube_rewrite.c ---- */
+
+static void generate_palette(void) {
+	for (int i = 0; i < 128; i++) {
+		uint8_t r = i / 2;
+		palette[i*3+0] = r;
+		palette[i*3+1] = (r * r) >> 6;
+		palette[i*3+2] = 0;
+	}
+	for (int i = 128; i < 256; i++) {
+		uint8_t d = 256 - i;
+		palette[i*3+0] = 0;
+		palette[i*3+1] = (d >> 1) & 0x3F;
+		palette[i*3+2] = (d >> 2) & 0x3F;
+	}
+}
+
+static void generate_texture(void) {
+	for (int i = 0; i < 65536; i++)
+		texture[i] = i & 0xFF;
+
+	uint16_t hash = 0;
+	uint8_t accum = 0xC9;
+	uint16_t idx = 0;
+	do {
+		hash = (uint16_t)((uint32_t)hash + idx);
+		int rot = (uint8_t)idx & 15;
+		if (rot)
+			hash = (hash << rot) | (hash >> (16 - rot));
+
+		int8_t tmp = (int8_t)(uint8_t)hash;
+		int carry = (tmp >> 4) & 1;
+		tmp >>= 5;
+		uint16_t r = (uint16_t)accum + (uint16_t)(uint8_t)tmp + carry;
+		accum = (uint8_t)r;
+		carry = r > 0xFF;
+		r = (uint16_t)accum + texture[(uint16_t)(idx + 255)] + carry;
+		accum = (uint8_t)r >> 1;
+
+		texture[idx] = accum;
+		texture[idx ^ 0xFF00] = accum;
+	} while (--idx);
+}
+
+/* ---- Fixed-point math ---- */
+
+/* cos/sin of a Q29 angle in [-pi, pi], both Q30 (CORDIC rotation mode) */
+static void cordic_sincos(int32_t angle, int32_t *co, int32_t *sn) {
+	int neg = 0;
+	if (angle > HALF_PI_Q29)       { angle -= PI_Q29; neg = 1; }
+	else if (angle < -HALF_PI_Q29) { angle += PI_Q29; neg = 1; }
+
+	int32_t x = CORDIC_K, y = 0, z = angle;
+	for (int i = 0; i < CORDIC_N; i++) {
+		int32_t dx = y >> i, dy = x >> i;
+		if (z >= 0) { x -= dx; y += dy; z -= cordic_atan[i]; }
+		else        { x += dx; y -= dy; z += cordic_atan[i]; }
+	}
+	*co = neg ? -x : x;
+	*sn = neg ? -y : y;
+}
+
+/* atan2(y, x) in Q29 for Q20 inputs (CORDIC vectoring mode) */
+static int32_t cordic_atan2(int32_t y, int32_t x) {
+	int32_t z = 0;
+	if (x < 0) {
+		/* Rotate by pi into the right half-plane */
+		z = (y >= 0) ? PI_Q29 : -PI_Q29;
+		x = -x;
+		y = -y;
+	}
+	for (int i = 0; i < CORDIC_N; i++) {
+		int32_t dx = y >> i, dy = x >> i;
+		if (y > 0) { x += dx; y -= dy; z += cordic_atan[i]; }
+		else       { x -= dx; y += dy; z -= cordic_atan[i]; }
+	}
+	return z;
+}
+
+/*
+ * 1/sqrt(r) for r > 0: returns y and sets *e so that 1/sqrt(r) = y * 2^-*e.
+ * r is normalized by an even shift to x in [1, 4) (Q30), 1/sqrt(x) is
+ * seeded from a 6-entry table and refined by 4 Newton steps
+ * y = y * (3 - x*y*y) / 2, each done in 64-bit integer arithmetic.
+ */
+static int32_t irsqrt(uint64_t r, int *e) {
+	static const int32_t seed[6] = {   /* 1/sqrt of bucket midpoints */
+		960383883, 811672525, 715827883, 647490682, 595604800, 554477894
+	};
+	int s = 0;
+	while (r >= ((uint64_t)1 << 32)) { r >>= 2; s += 2; }
+	while (r <  ((uint64_t)1 << 30)) { r <<= 2; s -= 2; }
+
+	int64_t x = (int64_t)r;
+	int64_t y = seed[(x >> 29) - 2];
+	for (int i = 0; i < 4; i++) {
+		int64_t t = (((x * y) >> 30) * y) >> 30;
+		y = (y * (((int64_t)3 << 30) - t)) >> 31;
+	}
+	*e = 45 + s / 2;   /* r = x * 2^(30 + s), y is Q30 */
+	return (int32_t)y;
+}
+
+/* Round a Qn value to the nearest integer */
+static int32_t round_q(int64_t v, int n) {
+	return (int32_t)((v + ((int64_t)1 << (n - 1))) >> n);
+}
+
+/* ---- Golden-frame comparison ---- */
+
+/* Count pixels of vga[] that differ from an 8-bit 320x200 BMP, -1 if unreadable */
+static long compare_bmp(const char *path) {
+	FILE *f = fopen(path, "rb");
+	if (!f) return -1;
+
+	uint8_t hdr[54];
+	if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || hdr[0] != 'B' || hdr[1] != 'M') {
+		fclose(f);
+		return -1;
+	}
+	uint32_t offset = hdr[10] | hdr[11] << 8 | hdr[12] << 16 | (uint32_t)hdr[13] << 24;
+	int32_t bw = hdr[18] | hdr[19] << 8 | hdr[20] << 16 | (uint32_t)hdr[21] << 24;
+	int32_t bh = hdr[22] | hdr[23] << 8 | hdr[24] << 16 | (uint32_t)hdr[25] << 24;
+	int bpp = hdr[28] | hdr[29] << 8;
+	if (bw != W || bh != H || bpp != 8 || fseek(f, offset, SEEK_SET) != 0) {
+		fclose(f);
+		return -1;
+	}
+
+	long diff = 0;
+	uint8_t line[W];
+	for (int y = H - 1; y >= 0; y--) {
+		if (fread(line, 1, W, f) != W) {
+			fclose(f);
+			return -1;
+		}
+		for (int x = 0; x < W; x++)
+			diff += line[x] != vga[y * W + x];
+	}
+	fclose(f);
+	return diff;
+}
+
+/* ================================================================ */
+
+int main(void)
+{
+	generate_palette();
+	generate_texture();
+	memset(vga, 0, sizeof(vga));
+	memset(pixbuf, 0, sizeof(pixbuf));
+
+	int32_t angle = 0;
+	uint8_t tex_phase = 0xFF;
+	long total = 0;
+
+	for (int frame = 0; frame < 25; frame++) {
+		tex_phase += 8;
+		uint16_t tex_ofs = ((uint16_t)tex_phase << 8) | 1;
+		angle += ANIM_Q29;
+		if (angle > PI_Q29) angle = angle - PI_Q29 - PI_Q29;
+
+		int32_t co30, sn30;
+		cordic_sincos(angle, &co30, &sn30);
+		int32_t co = round_q(co30, 30 - Q);
+		int32_t sn = round_q(sn30, 30 - Q);
+
+		int pi = 0;
+		for (int row = -(ROWS/2); row < ROWS/2; row++) {
+			for (int col = -(W/2); col < W/2; col++) {
+				/* Two successive 2D rotations by the same angle (Q20) */
+				int32_t y1 = col * co + row * sn;
+				int32_t z1 = row * co - col * sn;
+				int32_t p  = round_q((int64_t)y1 * co, Q) + EYE_DIST * sn;
+				int32_t q  = EYE_DIST * co - round_q((int64_t)y1 * sn, Q);
+
+				/* Cylindrical projection -> texture coordinates */
+				uint64_t r2 = (uint64_t)((int64_t)p * p) + (uint64_t)((int64_t)z1 * z1);
+				if (r2 == 0) r2 = 1;
+				int e;
+				int32_t inv = irsqrt(r2, &e);
+
+				/* q and radius are both Q20, so q / radius * TEX_SCALE is
+				 * q * TEX_SCALE * inv * 2^-e; inv loses 6 bits first to keep
+				 * the product within 64 bits */
+				int16_t tu = (int16_t)round_q((int64_t)cordic_atan2(p, z1) * TEX_SCALE, 29);
+				int16_t tv = (int16_t)round_q((int64_t)q * TEX_SCALE * (inv >> 6), e - 6);
+				uint16_t uv = (uint8_t)tu | ((uint16_t)(uint8_t)tv << 8);
+
+				/* Shading zone — bright/mid/dark based on address bits */
+				uint8_t shade;
+				uint16_t addr = (uint16_t)(tex_ofs + uv);
+				if (((uint8_t)addr + (uint8_t)(addr >> 8)) & 64) {
+					uv <<= 2;
+					addr = (uint16_t)(tex_ofs + uv);
+					if (((uint8_t)addr - (uint8_t)(addr >> 8)) & 0x80) {
+						uv <<= 1;
+						shade = (uint8_t)-48;
+					} else {
+						shade = (uint8_t)-16;
+					}
+				} else {
+					shade = (uint8_t)-5;
+				}
+
+				shade += texture[(uint16_t)(tex_ofs + uv)];
+				pixbuf[pi++] += shade;
+			}
+		}
+
+		/* Copy to VGA framebuffer, then fade pixel buffer toward black */
+		memcpy(vga + (H/2 - ROWS/2) * W, pixbuf, sizeof(pixbuf));
+		for (int i = 0; i < ROWS * W; i++)
+			pixbuf[i] = (uint8_t)((int8_t)pixbuf[i] >> 2);
+
+		char fname[32];
+		sprintf(fname, "rframe%03d.bmp", frame);
+		long diff = compare_bmp(fname);
+		if (diff < 0) {
+			fprintf(stderr, "%s: missing or unreadable, run ./tube_rewrite first\n", fname);
+			return 1;
+		}
+		printf("%s: %5ld of %d pixels differ (%.3f%%)\n",
+		       fname, diff, W * ROWS, 100.0 * diff / (W * ROWS));
+		total += diff;
+	}
+
+	printf("total: %ld of %d pixels differ (%.4f%%)\n",
+	       total, 25 * W * ROWS, 100.0 * total / (25 * W * ROWS));
+	return 0;
+}
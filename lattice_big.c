@@ -4,8 +4,24 @@
  * Raymarched Schwarz P-surface (triply periodic minimal surface) lattice.
  * Original 256-byte intro by baze, decompiled to C with SDL1.2.
  *
- * Usage: ./lattice_big [width height]
+ * Usage: ./lattice_big [options] [width height]
  * Defaults to 320x200 if no arguments given.
+ *
+ * Options:
+ *   --tex-layout L   texture memory layout: linear (default), tiled, morton
+ *   --fast-cos       SDF cosines from a 4 KB interpolated table
+ *   --simd-shade     shade each row in a separate 8-wide AVX2 pass
+ *   --steps N        march step budget (default 32)
+ *   --epsilon E      SDF hit threshold (default 0.09402)
+ *   --sweep N        time N frames at a grid of step budgets and
+ *                    thresholds against the default, then exit
+ *   --relax W        over-relaxed sphere tracing, steps of W * sdf
+ *                    (1 < W < 2)
+ *   --steps-hist     print the steps_left histogram with cosf and with
+ *                    --fast-cos over 100 frames, then exit
+ *   --bench N        render N frames without a window and print ms/frame
+ *   --soak N         time N frames at simulated uptimes up to a year, with
+ *                    and without camera range reduction
  */
 
 #include <SDL/SDL.h>
@@ -14,6 +30,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
 
 #define FPS      25
 #define FRAME_MS (1000 / FPS)
@@ -22,9 +44,10 @@
 #define UV_SCALE  41
 #define ZMOVE_INIT 968
 #define EPSILON   0.09402f
+#define RAY_NZ    0.30102999566f   /* log10(2) */
 
 static uint32_t palette[256];
-static uint8_t  texture[65536];
+static uint8_t  texture[65536 + 3];   /* +3: 32-bit gathers at index 65535 */
 
 static void init_palette(SDL_Surface *screen)
 {
@@ -78,17 +101,856 @@ static void init_texture(void)
     }
 }
 
+/*
+ * Texture memory layouts.  Texel (u, v) lives at texture[tex_addr(u, v)]:
+ * row-major (the original), 8x8 tiles of one cache line each, or Morton
+ * (Z-order) with u in the even and v in the odd bits.  The swizzled
+ * layouts keep texels that are close in both u and v on the same cache
+ * line; the translation is folded into the UV computation.
+ */
+enum { TEX_LINEAR, TEX_TILED, TEX_MORTON };
+static int tex_layout = TEX_LINEAR;
+
+static inline uint32_t spread_bits8(uint32_t x)
+{
+    x = (x | (x << 4)) & 0x0F0F;
+    x = (x | (x << 2)) & 0x3333;
+    x = (x | (x << 1)) & 0x5555;
+    return x;
+}
+
+static inline uint16_t tex_addr(int u_i, int v_i)
+{
+    uint32_t u = u_i & 0xFF;
+    uint32_t v = v_i & 0xFF;
+
+    switch (tex_layout) {
+    case TEX_TILED:
+        return (uint16_t)((u & 7) | (v & 7) << 3 | (u >> 3) << 6 | (v >> 3) << 11);
+    case TEX_MORTON:
+        return (uint16_t)(spread_bits8(u) | spread_bits8(v) << 1);
+    default:
+        return (uint16_t)((v << 8) | u);
+    }
+}
+
+/* Reorder texture[] in place into the selected layout (after init_texture) */
+static void swizzle_texture(void)
+{
+    static uint8_t linear[65536];
+    memcpy(linear, texture, sizeof(linear));
+    for (int i = 0; i < 65536; i++)
+        texture[tex_addr(i & 0xFF, i >> 8)] = linear[i];
+}
+
+/*
+ * --fast-cos: one period of cos sampled at COS_LUT_SIZE points (plus a
+ * wrap entry) and interpolated linearly.  4 KB stays in L1; the
+ * interpolation error is at most (2 pi / N)^2 / 8 ~ 5e-6, against an SDF
+ * that is compared with EPSILON ~ 0.094.
+ */
+#define COS_LUT_SIZE 1024
+
+static float cos_lut[COS_LUT_SIZE + 1];
+
+static void init_cos_lut(void)
+{
+    for (int i = 0; i <= COS_LUT_SIZE; i++)
+        cos_lut[i] = (float)cos(2.0 * M_PI * i / COS_LUT_SIZE);
+}
+
+static inline float cos_fast(float x)
+{
+    float t = x * (float)(COS_LUT_SIZE / (2.0 * M_PI));
+    int   i = (int)t - (t < 0.0f);   /* floor */
+    float f = t - (float)i;
+    const float *p = cos_lut + (i & (COS_LUT_SIZE - 1));
+    return p[0] + f * (p[1] - p[0]);
+}
+
+/*
+ * Unrotated ray directions (nx, ny, RAY_NZ), built once per resolution.
+ * The mapping from pixel to direction is separable, so the table holds
+ * nx per column and ny per row rather than a pair per pixel.  Both
+ * arrays are 32-byte aligned and padded to a multiple of 8 entries (the
+ * padding continues the mapping), so a row can be streamed 8 lanes at a
+ * time.
+ */
+static float *ray_nx, *ray_ny;
+
+static int init_ray_table(int W, int H)
+{
+    size_t wn = ((size_t)W + 7) & ~(size_t)7;
+    size_t hn = ((size_t)H + 7) & ~(size_t)7;
+
+    ray_nx = (float *)aligned_alloc(32, wn * sizeof(float));
+    ray_ny = (float *)aligned_alloc(32, hn * sizeof(float));
+    if (!ray_nx || !ray_ny)
+        return -1;
+    for (size_t col = 0; col < wn; col++)
+        ray_nx[col] = ((col + 0.5f) / W * 320.0f - 160.0f) / EYE_VAL;
+    for (size_t row = 0; row < hn; row++)
+        ray_ny[row] = ((row + 0.5f) / H * 200.0f - 100.0f) / EYE_VAL;
+    return 0;
+}
+
+/*
+ * March budget and hit threshold (--steps, --epsilon).  The original
+ * marches 32 steps and darkens by steps_left * 2, i.e. by 2 per step
+ * taken.  bright_lut keeps that for any budget: a ray that hits after k
+ * steps gets 2 * (32 - k) (clamped at 0) whatever the budget, so a
+ * smaller budget only turns the rays that need more steps into misses,
+ * and a larger one only adds hits past step 32, which stay black.
+ */
+#define MAX_STEPS 255
+
+static int     march_steps = 32;
+static float   march_eps   = EPSILON;
+static uint8_t bright_lut[MAX_STEPS + 1 + 3];   /* +3: 32-bit gathers */
+
+/*
+ * --relax: over-relaxed sphere tracing (Keinert et al., "Enhanced Sphere
+ * Tracing").  Each step advances march_relax * sdf instead of sdf.  The
+ * unbounded sphere of the new point must still overlap the previous
+ * one (|sdf| + previous |sdf| >= step length); if not, the step may have
+ * jumped a thin feature, so the ray backs up to a point inside the
+ * previous sphere without a hit test and marches plainly from there.
+ * A failed step costs an SDF evaluation like any other.
+ */
+static float march_relax = 1.0f;
+
+static void set_march(int steps, float eps)
+{
+    march_steps = steps;
+    march_eps   = eps;
+    for (int s = 0; s <= MAX_STEPS; s++)
+        bright_lut[s] = (uint8_t)(s == 0 || s > steps || s + 32 <= steps
+                                  ? 0 : 2 * (s + 32 - steps));
+}
+
+/*
+ * --simd-shade: shading as a separate stage.  The marcher leaves a row's
+ * hit points and step counts in a hit_row_t (one array per field) and
+ * the stage turns the whole row into pixbuf bytes, so shade_row_avx2 can
+ * do the atan2, the two roundings and the texel loads 8 pixels at a time.
+ */
+typedef struct {
+    float   *x, *y, *z;
+    int32_t *steps_left;
+} hit_row_t;
+
+typedef void (*shade_row_fn)(uint8_t *dst, const hit_row_t *hits, int n,
+                             float v_phase);
+
+/* Per-frame render state */
+typedef struct {
+    int       W, H;
+    uint8_t  *pixbuf;
+    uint8_t  *steps;       /* optional: steps_left per pixel */
+    float     rot[3][3];   /* (nx, ny, nz) -> step along posX, posY, posZ */
+    float     cam_z;       /* reduced to [0, 2 pi) */
+    float     v_phase;     /* texture v offset of the dropped periods */
+    shade_row_fn shade;    /* --simd-shade stage, or NULL: shade per pixel */
+} frame_params_t;
+
+/*
+ * The original rotates each ray twice by the same angle: (nx, ny) into
+ * (x1, y1), then (nz, x1) into (rx, rz); y1 steps posX, rx posY and rz
+ * posZ.  Both rotations fold into one matrix per frame, worked out in
+ * double and rounded once.
+ */
+static void camera_rotation(frame_params_t *fp, double c, double s)
+{
+    fp->rot[0][0] = (float)-s;
+    fp->rot[0][1] = (float)c;
+    fp->rot[0][2] = 0.0f;
+    fp->rot[1][0] = (float)(c * c);
+    fp->rot[1][1] = (float)(s * c);
+    fp->rot[1][2] = (float)s;
+    fp->rot[2][0] = (float)(-c * s);
+    fp->rot[2][1] = (float)(-s * s);
+    fp->rot[2][2] = (float)c;
+}
+
+/*
+ * Camera state for frame position zmove.  zmove runs down without bound,
+ * so it is kept in double and reduced here, outside the pixel loop: the
+ * rotation angle modulo 2 pi, and the camera Z modulo the 2 pi period of
+ * the SDF.  Dropping k periods from Z shifts the texture v coordinate by
+ * k * 2 pi * UV_SCALE texels, carried modulo 256 in v_phase.  Rays start
+ * within one period of the origin and march at most MAX_STEPS, so cosf
+ * only ever sees small arguments, however long the program has run.
+ */
+static void camera_state(frame_params_t *fp, double zmove)
+{
+    double angle = fmod(zmove / 41.0, 2.0 * M_PI);
+    double z = zmove / M_PI;
+    double k = floor(z / (2.0 * M_PI));
+
+    camera_rotation(fp, cos(angle), sin(angle));
+    fp->cam_z   = (float)(z - k * 2.0 * M_PI);
+    fp->v_phase = (float)fmod(k * 2.0 * M_PI * UV_SCALE, 256.0);
+}
+
+typedef void (*render_frame_fn)(const frame_params_t *fp);
+
+/* Texel at the hit point darkened by the steps taken */
+static inline __attribute__((always_inline)) uint8_t
+lattice_shade(float posX, float posY, float posZ, int steps_left,
+              float v_phase)
+{
+    int u_i = (int)lrintf(atan2f(posY, posX) * UV_SCALE);
+    int v_i = (int)lrintf(posZ * UV_SCALE + v_phase);
+    uint16_t uv = tex_addr(u_i, v_i);
+
+    uint8_t tex_val = texture[uv];
+    uint8_t neg_tex = (uint8_t)(-(int8_t)tex_val);
+    uint8_t bright  = bright_lut[steps_left];
+    uint16_t product = (uint16_t)neg_tex * (uint16_t)bright;
+
+    return (uint8_t)(product >> 8);
+}
+
+static void shade_row_scalar(uint8_t *dst, const hit_row_t *hits, int n,
+                             float v_phase)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = lattice_shade(hits->x[i], hits->y[i], hits->z[i],
+                               hits->steps_left[i], v_phase);
+}
+
+/* Row buffers for W pixels, rounded up to a multiple of 8 */
+static int hit_row_alloc(hit_row_t *hits, int W)
+{
+    size_t n = ((size_t)W + 7) & ~(size_t)7;
+    float *p = (float *)malloc(sizeof(float) * 4 * n);
+    if (!p)
+        return -1;
+    hits->x = p;
+    hits->y = p + n;
+    hits->z = p + 2 * n;
+    hits->steps_left = (int32_t *)(p + 3 * n);
+    return 0;
+}
+
+static inline __attribute__((always_inline)) void
+render_frame_kernel(const frame_params_t *fp, int fast_cos, int relax)
+{
+    int   W = fp->W, H = fp->H;
+    const float (*m)[3] = fp->rot;
+    float cam_z = fp->cam_z;
+    float v_phase = fp->v_phase;
+    uint8_t *pixbuf = fp->pixbuf;
+    int   max_steps = march_steps;
+    float eps = march_eps;
+    shade_row_fn shade = fp->shade;
+    hit_row_t hits = { 0 };
+
+    if (shade && hit_row_alloc(&hits, W) < 0)
+        shade = NULL;
+
+    int pi = 0;
+    for (int row = 0; row < H; row++) {
+        /* The ny and nz terms of the rotation are constant along a row */
+        float ny = ray_ny[row];
+        float by = m[0][1] * ny + m[0][2] * RAY_NZ;
+        float bx = m[1][1] * ny + m[1][2] * RAY_NZ;
+        float bz = m[2][1] * ny + m[2][2] * RAY_NZ;
+
+        for (int col = 0; col < W; col++, pi++) {
+            float nx = ray_nx[col];
+            float ry = m[0][0] * nx + by;
+            float rx = m[1][0] * nx + bx;
+            float rz = m[2][0] * nx + bz;
+
+            float posX = 0.0f;
+            float posY = 0.0f;
+            float posZ = cam_z;
+            int   steps_left = 0;
+            float omega = march_relax, prev_r = 0.0f, step_len = 0.0f;
+
+            for (int step = 0; step < max_steps; step++) {
+                float sdf = fast_cos
+                          ? cos_fast(posZ) + cos_fast(posY) + cos_fast(posX)
+                            + 0.69314718f
+                          : cosf(posZ) + cosf(posY) + cosf(posX)
+                            + 0.69314718f;
+
+                if (relax) {
+                    float r = fabsf(sdf);
+                    if (omega > 1.0f && r + prev_r < step_len) {
+                        /* Back into the previous sphere, plain from here */
+                        step_len -= omega * step_len;
+                        omega = 1.0f;
+                        prev_r = r;
+                        posX += step_len * ry;
+                        posY += step_len * rx;
+                        posZ += step_len * rz;
+                        continue;
+                    }
+                    prev_r = r;
+                }
+                int is_hit = (sdf < eps);
+                float adv = relax && !is_hit ? sdf * omega : sdf;
+                step_len = adv;
+
+                posX += adv * ry;
+                posY += adv * rx;
+                posZ += adv * rz;
+
+                if (is_hit) {
+                    steps_left = max_steps - step;
+                    break;
+                }
+            }
+
+            if (shade) {
+                hits.x[col] = posX;
+                hits.y[col] = posY;
+                hits.z[col] = posZ;
+                hits.steps_left[col] = steps_left;
+            } else {
+                pixbuf[pi] = lattice_shade(posX, posY, posZ, steps_left, v_phase);
+            }
+            if (fp->steps)
+                fp->steps[pi] = (uint8_t)steps_left;
+        }
+        if (shade)
+            shade(pixbuf + (size_t)row * W, &hits, W, v_phase);
+    }
+    free(hits.x);
+}
+
+/* Kernel instances: render_frame_kernel with its mode flags fixed */
+static void render_frame_scalar(const frame_params_t *fp)
+{
+    render_frame_kernel(fp, 0, 0);
+}
+
+static void render_frame_fast_cos(const frame_params_t *fp)
+{
+    render_frame_kernel(fp, 1, 0);
+}
+
+static void render_frame_relax(const frame_params_t *fp)
+{
+    render_frame_kernel(fp, 0, 1);
+}
+
+static void render_frame_relax_fast_cos(const frame_params_t *fp)
+{
+    render_frame_kernel(fp, 1, 1);
+}
+
+#ifdef HAVE_AVX2_KERNEL
+
+/*
+ * AVX2 shading stage.  Compiled with a target attribute so the rest of
+ * the file keeps the baseline ISA; main() only selects it after a
+ * runtime CPU check.
+ */
+#define AVX2_FN __attribute__((target("avx2")))
+
+/* atan2(y, x) via octant reduction and a degree-11 odd minimax polynomial
+ * for atan on [0, 1] (max error ~1e-5 rad, i.e. ~4e-4 texel at UV_SCALE) */
+AVX2_FN static inline __m256 atan2_avx2(__m256 y, __m256 x)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign, x);
+    __m256 ay = _mm256_andnot_ps(sign, y);
+    __m256 mx = _mm256_max_ps(ax, ay);
+    __m256 mn = _mm256_min_ps(ax, ay);
+    __m256 a  = _mm256_div_ps(mn, _mm256_max_ps(mx, _mm256_set1_ps(1e-30f)));
+    __m256 s  = _mm256_mul_ps(a, a);
+
+    __m256 r = _mm256_set1_ps(-0.01172120f);
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.05265332f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(-0.11643287f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.19354346f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(-0.33262347f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.99997726f));
+    r = _mm256_mul_ps(r, a);
+
+    /* |y| > |x|: pi/2 - r;  x < 0: pi - r;  then take the sign of y */
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.57079637f), r),
+                         _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(3.14159274f), r), x);
+    return _mm256_or_ps(r, _mm256_and_ps(sign, y));
+}
+
+/* Vector tex_addr for 8 texel indices (v << 8 | u) in 32-bit lanes */
+AVX2_FN static inline __m256i tex_swizzle_avx2(__m256i idx)
+{
+    __m256i u = _mm256_and_si256(idx, _mm256_set1_epi32(0xFF));
+    __m256i v = _mm256_srli_epi32(idx, 8);
+
+    if (tex_layout == TEX_TILED) {
+        const __m256i m7 = _mm256_set1_epi32(7);
+        return _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(u, m7),
+                            _mm256_slli_epi32(_mm256_and_si256(v, m7), 3)),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(u, 3), 6),
+                            _mm256_slli_epi32(_mm256_srli_epi32(v, 3), 11)));
+    }
+
+    /* Morton: spread u and v together, v pre-shifted into the odd bits */
+    __m256i x = _mm256_or_si256(u, _mm256_slli_epi32(v, 16));
+    x = _mm256_and_si256(_mm256_or_si256(x, _mm256_slli_epi32(x, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+    x = _mm256_and_si256(_mm256_or_si256(x, _mm256_slli_epi32(x, 2)), _mm256_set1_epi32(0x33333333));
+    x = _mm256_and_si256(_mm256_or_si256(x, _mm256_slli_epi32(x, 1)), _mm256_set1_epi32(0x55555555));
+    return _mm256_and_si256(_mm256_or_si256(x, _mm256_srli_epi32(x, 15)), _mm256_set1_epi32(0xFFFF));
+}
+
+/*
+ * lattice_shade for 8 pixels.  The roundings are cvtps (nearest-even,
+ * like lrintf) and the texels come from a 32-bit gather; only the
+ * polynomial atan2 differs from the scalar stage.
+ */
+AVX2_FN static void shade_row_avx2(uint8_t *dst, const hit_row_t *hits, int n,
+                                   float v_phase)
+{
+    const __m256  scale = _mm256_set1_ps((float)UV_SCALE);
+    const __m256  phase = _mm256_set1_ps(v_phase);
+    const __m256i m8    = _mm256_set1_epi32(0xFF);
+    const __m256i lo4   = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(hits->x + i);
+        __m256 y = _mm256_loadu_ps(hits->y + i);
+        __m256 z = _mm256_loadu_ps(hits->z + i);
+        __m256i sl = _mm256_loadu_si256((const __m256i *)(hits->steps_left + i));
+
+        __m256i u_i = _mm256_cvtps_epi32(_mm256_mul_ps(atan2_avx2(y, x), scale));
+        __m256i v_i = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(z, scale), phase));
+        __m256i uv  = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(v_i, m8), 8),
+                                      _mm256_and_si256(u_i, m8));
+        if (tex_layout != TEX_LINEAR)
+            uv = tex_swizzle_avx2(uv);
+
+        /* (uint8_t)-texel * bright_lut[steps_left] >> 8 */
+        __m256i tex = _mm256_and_si256(
+            _mm256_i32gather_epi32((const int *)texture, uv, 1), m8);
+        __m256i neg = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), tex), m8);
+        __m256i bright = _mm256_and_si256(
+            _mm256_i32gather_epi32((const int *)bright_lut, sl, 1), m8);
+        __m256i pix = _mm256_srli_epi32(_mm256_mullo_epi32(neg, bright), 8);
+
+        /* Low byte of each lane */
+        pix = _mm256_shuffle_epi8(pix, lo4);
+        uint64_t packed = (uint32_t)_mm256_extract_epi32(pix, 0)
+                        | ((uint64_t)(uint32_t)_mm256_extract_epi32(pix, 4) << 32);
+        memcpy(dst + i, &packed, 8);
+    }
+
+    hit_row_t tail = {
+        hits->x + i, hits->y + i, hits->z + i, hits->steps_left + i
+    };
+    shade_row_scalar(dst + i, &tail, n - i, v_phase);
+}
+
+static int have_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+static int have_avx2(void)
+{
+    return 0;
+}
+
+#endif /* HAVE_AVX2_KERNEL */
+
+/* --bench: render `frames` frames at speed 1 without a window, then
+ * render them again untimed to count the SDF steps per pixel from
+ * steps_left (a ray that hits with steps_left s took max - s + 1 steps,
+ * one that misses took max) */
+static int bench_mode(render_frame_fn render, const char *kernel,
+                      shade_row_fn shade, int W, int H, int frames)
+{
+    size_t n = (size_t)W * H;
+    uint8_t *pixbuf = (uint8_t *)malloc(n);
+    uint8_t *steps  = (uint8_t *)malloc(n);
+    if (!pixbuf || !steps) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double steps_total = 0.0, long_rays = 0.0;
+
+    double zmove = ZMOVE_INIT;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fp = {
+            .W = W, .H = H, .pixbuf = pixbuf, .shade = shade
+        };
+        camera_state(&fp, zmove);
+        render(&fp);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+    zmove = ZMOVE_INIT;
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fp = {
+            .W = W, .H = H, .pixbuf = pixbuf, .steps = steps, .shade = shade
+        };
+        camera_state(&fp, zmove);
+        render(&fp);
+
+        for (size_t i = 0; i < n; i++) {
+            int taken = steps[i] ? march_steps + 1 - steps[i] : march_steps;
+            steps_total += taken;
+            long_rays += (taken * 4 >= march_steps * 3);
+        }
+    }
+    printf("bench %dx%d, %s kernel%s: %d frames, %.2f ms/frame, %.1f Mpixel/s\n",
+           W, H, kernel,
+           shade == NULL ? "" : shade == shade_row_scalar ? ", row shading"
+                                                          : ", avx2 shading",
+           frames, ms / frames, (double)W * H * frames / (ms * 1e3));
+    printf("avg steps/pixel: %.2f, %.2f%% of rays take 3/4 of the budget or more\n",
+           steps_total / ((double)n * frames), 100.0 * long_rays / ((double)n * frames));
+
+    free(steps);
+    free(pixbuf);
+    return 0;
+}
+
+/* The unreduced single-precision camera state used before camera_state(),
+ * kept for --soak to compare against */
+static void camera_state_float(frame_params_t *fp, double zmove)
+{
+    float zmove_f = (float)zmove;
+    float angle   = zmove_f / 41.0f;
+
+    camera_rotation(fp, cosf(angle), sinf(angle));
+    fp->cam_z   = zmove_f / (float)M_PI;
+    fp->v_phase = 0.0f;
+}
+
+/* --soak: time `frames` frames at simulated uptimes from a fresh start to
+ * a year (25 fps, speed 1) with the reduced camera state and with the
+ * unreduced float one, and count the pixels where the two disagree */
+static int soak_mode(render_frame_fn render, const char *kernel, int W, int H,
+                     int frames)
+{
+    static const struct { const char *name; double sec; } uptimes[] = {
+        { "0",      0.0 },
+        { "1 h",    3600.0 },
+        { "1 day",  86400.0 },
+        { "1 week", 7 * 86400.0 },
+        { "30 days", 30 * 86400.0 },
+        { "1 year", 365 * 86400.0 },
+    };
+    size_t n = (size_t)W * H;
+    uint8_t *pa = (uint8_t *)malloc(n), *pb = (uint8_t *)malloc(n);
+    if (!pa || !pb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("soak %dx%d, %s kernel, %d frames per uptime\n", W, H, kernel, frames);
+    printf("%8s %14s %14s %14s %10s\n",
+           "uptime", "zmove", "reduced ms", "float ms", "differ");
+
+    for (size_t u = 0; u < sizeof(uptimes) / sizeof(uptimes[0]); u++) {
+        double zmove0 = ZMOVE_INIT - uptimes[u].sec * FPS;
+        double ms[2];
+        long   diff = 0;
+
+        for (int pass = 0; pass < 2; pass++) {
+            double zmove = zmove0, t = 0.0;
+            for (int f = 0; f < frames; f++) {
+                zmove -= 1.0;
+                frame_params_t fp = { .W = W, .H = H, .pixbuf = pass ? pb : pa };
+                if (pass)
+                    camera_state_float(&fp, zmove);
+                else
+                    camera_state(&fp, zmove);
+
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                render(&fp);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                t += (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+                if (pass) {
+                    /* the reduced frame is re-rendered into pa for the diff */
+                    frame_params_t fr = { .W = W, .H = H, .pixbuf = pa };
+                    camera_state(&fr, zmove);
+                    render(&fr);
+                    for (size_t i = 0; i < n; i++)
+                        diff += (pa[i] != pb[i]);
+                }
+            }
+            ms[pass] = t / frames;
+        }
+
+        printf("%8s %14.0f %14.2f %14.2f %9.2f%%\n", uptimes[u].name, zmove0,
+               ms[0], ms[1], 100.0 * diff / ((double)n * frames));
+    }
+
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+/*
+ * --sweep: render `frames` frames of the default camera path at a grid of
+ * step budgets and hit thresholds, and print ms/frame against how many
+ * pixels differ from the 32-step, EPSILON frame: at all, by how many
+ * palette indices where they do, and by more than 4 (pixbuf spans
+ * 0..63, so that is a visible step).  Settings marked * hold 25 fps.
+ */
+static int sweep_mode(render_frame_fn render, const char *kernel,
+                      shade_row_fn shade, int W, int H, int frames)
+{
+    static const int   budgets[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+    static const float eps_scale[] = { 0.5f, 1.0f, 2.0f };
+    size_t n = (size_t)W * H;
+    uint8_t *pa = (uint8_t *)malloc(n), *pb = (uint8_t *)malloc(n);
+    if (!pa || !pb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("sweep %dx%d, %s kernel, %d frames per setting\n", W, H, kernel, frames);
+    printf("%6s %9s %10s %7s %9s %9s %9s\n",
+           "steps", "epsilon", "ms/frame", "fps", "differ", "mean |d|", "|d| > 4");
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+        for (size_t e = 0; e < sizeof(eps_scale) / sizeof(eps_scale[0]); e++) {
+            float eps = EPSILON * eps_scale[e];
+            double zmove = ZMOVE_INIT, t = 0.0;
+            long diff = 0, absdiff = 0, visible = 0;
+
+            for (int f = 0; f < frames; f++) {
+                zmove -= 1.0;
+                frame_params_t fa = { .W = W, .H = H, .pixbuf = pa, .shade = shade };
+                camera_state(&fa, zmove);
+                frame_params_t fb = fa;
+                fb.pixbuf = pb;
+
+                set_march(32, EPSILON);
+                render(&fa);
+                set_march(budgets[b], eps);
+
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                render(&fb);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                t += (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+                for (size_t i = 0; i < n; i++) {
+                    int d = abs(pa[i] - pb[i]);
+                    diff += (d != 0);
+                    absdiff += d;
+                    visible += (d > 4);
+                }
+            }
+
+            double ms = t / frames;
+            printf("%6d %9.5f %10.2f %7.1f %8.2f%% %9.2f %8.2f%%%s\n",
+                   budgets[b], eps, ms, 1000.0 / ms,
+                   100.0 * diff / ((double)n * frames),
+                   diff ? (double)absdiff / diff : 0.0,
+                   100.0 * visible / ((double)n * frames),
+                   ms <= FRAME_MS ? " *" : "");
+        }
+    }
+    set_march(32, EPSILON);
+
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+/* --steps-hist: render 100 frames at speed 1 with cosf and with the
+ * table, and print how often each steps_left value occurs in both */
+static int steps_hist_mode(int W, int H)
+{
+    const int frames = 100;
+    size_t n = (size_t)W * H;
+    uint8_t *pa = (uint8_t *)malloc(n), *pb = (uint8_t *)malloc(n);
+    uint8_t *sa = (uint8_t *)malloc(n), *sb = (uint8_t *)malloc(n);
+    if (!pa || !pb || !sa || !sb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    long hist[2][MAX_STEPS + 1] = { { 0 } };
+    long steps_diff = 0, pix_diff = 0;
+    double zmove = ZMOVE_INIT;
+
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fa = {
+            .W = W, .H = H, .pixbuf = pa, .steps = sa
+        };
+        camera_state(&fa, zmove);
+        frame_params_t fb = fa;
+        fb.pixbuf = pb;
+        fb.steps = sb;
+
+        render_frame_scalar(&fa);
+        render_frame_fast_cos(&fb);
+
+        for (size_t i = 0; i < n; i++) {
+            hist[0][sa[i]]++;
+            hist[1][sb[i]]++;
+            steps_diff += (sa[i] != sb[i]);
+            pix_diff += (pa[i] != pb[i]);
+        }
+    }
+
+    printf("steps_left histogram, %dx%d, %d frames\n", W, H, frames);
+    printf("steps_left        cosf    fast-cos        diff\n");
+    for (int s = 0; s <= march_steps; s++) {
+        if (hist[0][s] || hist[1][s])
+            printf("%10d %11ld %11ld %+11ld\n",
+                   s, hist[0][s], hist[1][s], hist[1][s] - hist[0][s]);
+    }
+    printf("steps_left differs at %ld of %zu pixels (%.4f%%), "
+           "output at %ld (%.4f%%)\n",
+           steps_diff, n * frames, 100.0 * steps_diff / ((double)n * frames),
+           pix_diff, 100.0 * pix_diff / ((double)n * frames));
+
+    free(sb);
+    free(sa);
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [width height]\n"
+        "  --tex-layout L   texture layout: linear, tiled or morton\n"
+        "  --fast-cos       SDF cosines from an interpolated table\n"
+        "  --simd-shade     shade rows in a separate AVX2 pass\n"
+        "  --steps N        march step budget, 1..255 (default 32)\n"
+        "  --epsilon E      SDF hit threshold (default 0.09402)\n"
+        "  --sweep N        time N frames per budget/threshold setting\n"
+        "  --relax W        over-relaxed sphere tracing, 1 < W < 2\n"
+        "  --steps-hist     compare steps_left with and without --fast-cos\n"
+        "  --bench N        render N frames without a window, print ms/frame\n"
+        "  --soak N         time N frames at simulated uptimes up to a year\n",
+        prog);
+}
+
 int main(int argc, char *argv[])
 {
     int W = 320, H = 200;
-    if (argc >= 3) {
-        W = atoi(argv[1]);
-        H = atoi(argv[2]);
-        if (W <= 0 || H <= 0) {
-            fprintf(stderr, "Usage: %s [width height]\n", argv[0]);
+    int bench_frames = 0;
+    int fast_cos = 0, steps_hist = 0, soak_frames = 0, simd_shade = 0;
+    int steps = 32, sweep_frames = 0;
+    float eps = EPSILON, relax = 1.0f;
+    const char *pos[2];
+    int npos = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tex-layout") == 0 && i + 1 < argc) {
+            const char *l = argv[++i];
+            if (strcmp(l, "linear") == 0) {
+                tex_layout = TEX_LINEAR;
+            } else if (strcmp(l, "tiled") == 0) {
+                tex_layout = TEX_TILED;
+            } else if (strcmp(l, "morton") == 0) {
+                tex_layout = TEX_MORTON;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fast-cos") == 0) {
+            fast_cos = 1;
+        } else if (strcmp(argv[i], "--steps-hist") == 0) {
+            steps_hist = 1;
+        } else if (strcmp(argv[i], "--simd-shade") == 0) {
+            simd_shade = 1;
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc) {
+            eps = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--relax") == 0 && i + 1 < argc) {
+            relax = (float)atof(argv[++i]);
+            if (!(relax > 1.0f && relax < 2.0f)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            soak_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' || npos == 2) {
+            usage(argv[0]);
             return 1;
+        } else {
+            pos[npos++] = argv[i];
         }
     }
+    if (npos == 2) {
+        W = atoi(pos[0]);
+        H = atoi(pos[1]);
+    }
+    if (W <= 0 || H <= 0 || npos == 1 ||
+        steps < 1 || steps > MAX_STEPS || !(eps > 0.0f)) {
+        usage(argv[0]);
+        return 1;
+    }
+    set_march(steps, eps);
+    march_relax = relax;
+    if (init_ray_table(W, H) < 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    const char *kernel = "scalar";
+    render_frame_fn render = render_frame_scalar;
+    init_cos_lut();
+    if (fast_cos) {
+        render = render_frame_fast_cos;
+        kernel = "fast-cos";
+    }
+    if (relax > 1.0f) {
+        render = fast_cos ? render_frame_relax_fast_cos : render_frame_relax;
+        kernel = fast_cos ? "relax+fast-cos" : "relax";
+    }
+    shade_row_fn shade = NULL;
+    if (simd_shade) {
+        shade = shade_row_scalar;
+#ifdef HAVE_AVX2_KERNEL
+        if (have_avx2())
+            shade = shade_row_avx2;
+#endif
+        if (shade == shade_row_scalar)
+            fprintf(stderr, "lattice_big: no AVX2, using scalar shading\n");
+    }
+
+    if (steps_hist || soak_frames > 0 || sweep_frames > 0 || bench_frames > 0) {
+        init_texture();
+        if (tex_layout != TEX_LINEAR)
+            swizzle_texture();
+        if (steps_hist)
+            return steps_hist_mode(W, H);
+        if (soak_frames > 0)
+            return soak_mode(render, kernel, W, H, soak_frames);
+        if (sweep_frames > 0)
+            return sweep_mode(render, kernel, shade, W, H, sweep_frames);
+        return bench_mode(render, kernel, shade, W, H, bench_frames);
+    }
 
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
@@ -106,8 +968,10 @@ int main(int argc, char *argv[])
 
     init_palette(screen);
     init_texture();
+    if (tex_layout != TEX_LINEAR)
+        swizzle_texture();
 
-    float zmove_f = (float)ZMOVE_INIT;
+    double zmove = ZMOVE_INIT;
     float speed_mult = 1.0f;
     int   screenshot_counter = 0;
     int   take_screenshot = 0;
@@ -145,64 +1009,11 @@ int main(int argc, char *argv[])
             }
         }
 
-        zmove_f -= speed_mult;
-        float angle = zmove_f / 41.0f;
-        float cosa  = cosf(angle);
-        float sina  = sinf(angle);
-        float cam_z = zmove_f / (float)M_PI;
-
-        int pi = 0;
-        for (int row = 0; row < H; row++) {
-            for (int col = 0; col < W; col++, pi++) {
-                /* Map output pixel to original coordinate space */
-                float px_f = (col + 0.5f) / W * 320.0f - 160.0f;
-                float py_f = (row + 0.5f) / H * 200.0f - 100.0f;
-
-                float nx = px_f / EYE_VAL;
-                float ny = py_f / EYE_VAL;
-                float nz = 0.30102999566f;  /* log10(2) */
-
-                /* First rotation: (nx, ny) plane */
-                float x1 = nx * cosa + ny * sina;
-                float y1 = ny * cosa - nx * sina;
-
-                /* Second rotation: (nz, x1) plane */
-                float rx = x1 * cosa + nz * sina;
-                float rz = nz * cosa - x1 * sina;
-                float ry = y1;
-
-                float posX = 0.0f;
-                float posY = 0.0f;
-                float posZ = cam_z;
-                int   steps_left = 0;
-
-                for (int step = 0; step < 32; step++) {
-                    float sdf = cosf(posZ) + cosf(posY) + cosf(posX)
-                              + 0.69314718f;
-                    int is_hit = (sdf < EPSILON);
-
-                    posX += sdf * ry;
-                    posY += sdf * rx;
-                    posZ += sdf * rz;
-
-                    if (is_hit) {
-                        steps_left = 32 - step;
-                        break;
-                    }
-                }
-
-                int u_i = (int)lrintf(atan2f(posY, posX) * UV_SCALE);
-                int v_i = (int)lrintf(posZ * UV_SCALE);
-                uint16_t uv = (uint16_t)(((v_i & 0xFF) << 8) | (u_i & 0xFF));
+        zmove -= speed_mult;
 
-                uint8_t tex_val = texture[uv];
-                uint8_t neg_tex = (uint8_t)(-(int8_t)tex_val);
-                uint8_t bright  = (uint8_t)(steps_left * 2);
-                uint16_t product = (uint16_t)neg_tex * (uint16_t)bright;
-
-                pixbuf[pi] = (uint8_t)(product >> 8);
-            }
-        }
+        frame_params_t fp = { .W = W, .H = H, .pixbuf = pixbuf, .shade = shade };
+        camera_state(&fp, zmove);
+        render(&fp);
 
         /* Blit to screen */
         if (SDL_MUSTLOCK(screen))
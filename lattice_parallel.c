@@ -4,11 +4,43 @@
  * Raymarched Schwarz P-surface (triply periodic minimal surface) lattice.
  * Original 256-byte intro by baze, decompiled to C.
  *
- * Usage: ./lattice_parallel [width height]
+ * Usage: ./lattice_parallel [options] [width height]
  *   width height  - window size (default 320x200)
  *
+ * Options:
+ *   --simd        8-wide AVX2 sphere tracer (polynomial cosine)
+ *   --fast-cos    SDF cosines from a 4 KB interpolated table (scalar)
+ *   --steps-hist  print the steps_left histogram with cosf and with
+ *                 --fast-cos over 100 frames, then exit
+ *   --reproject F seed each ray at fraction F of the previous frame's hit
+ *                 distance, reprojected to the new camera (scalar kernels)
+ *   --subsample N trace every Nth pixel (2 or 4) first, then only the cells
+ *                 whose corners disagree; interpolate the rest (scalar)
+ *   --sub-steps T, --sub-uv T
+ *                 corner disagreement thresholds in steps_left (default 1)
+ *                 and texels (default 4)
+ *   --cone N      march one bounding cone per NxN tile first and start
+ *                 the tile's rays where it stops (scalar kernels)
+ *   --cone-stats  with --cone: steps saved per tile over 100 frames
+ *   --simd-shade  shade each row in a separate 8-wide AVX2 pass (any
+ *                 kernel but --subsample)
+ *   --heatmap     record SDF steps per pixel and wall time per row; show
+ *                 them over the picture (H toggles, D dumps PGM + CSV)
+ *   --balance     split rows between the threads by the CPU time each
+ *                 row took in the previous frame
+ *   --relax W     over-relaxed sphere tracing, steps of W * sdf with
+ *                 1 < W < 2 (scalar kernels)
+ *   --steps N     march step budget (default 32)
+ *   --epsilon E   SDF hit threshold (default 0.09402)
+ *   --sweep N     time N frames on the worker pool at a grid of step
+ *                 budgets and thresholds against the default, then exit
+ *   --verify      compare the selected kernel against the scalar one over
+ *                 100 frames, print how many pixels differ, and exit
+ *   --bench N     render N frames without a window and print ms/frame
+ *
  * Set THREADS env var to control thread count (default 16).
- * Controls: +/- speed, S screenshot, ESC quit.
+ * Controls: +/- speed, S screenshot, ESC quit; with --heatmap, H toggles
+ * the overlay and D dumps the last frame's heatmap and row times.
  */
 
 #include <SDL/SDL.h>
@@ -18,6 +50,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
 
 #define FPS      25
 #define FRAME_MS (1000 / FPS)
@@ -26,9 +64,10 @@
 #define UV_SCALE  41
 #define ZMOVE_INIT 968
 #define EPSILON   0.09402f
+#define RAY_NZ    0.30102999566f   /* log10(2) */
 
 static uint32_t palette[256];
-static uint8_t  texture[65536];
+static uint8_t  texture[65536 + 3];   /* +3: 32-bit gathers at index 65535 */
 
 static void init_palette(SDL_Surface *screen)
 {
@@ -82,82 +121,1309 @@ static void init_texture(void)
     }
 }
 
+/*
+ * --fast-cos: one period of cos sampled at COS_LUT_SIZE points (plus a
+ * wrap entry) and interpolated linearly.  4 KB stays in L1; the
+ * interpolation error is at most (2 pi / N)^2 / 8 ~ 5e-6, against an SDF
+ * that is compared with EPSILON ~ 0.094.
+ */
+#define COS_LUT_SIZE 1024
+
+static float cos_lut[COS_LUT_SIZE + 1];
+
+static void init_cos_lut(void)
+{
+    for (int i = 0; i <= COS_LUT_SIZE; i++)
+        cos_lut[i] = (float)cos(2.0 * M_PI * i / COS_LUT_SIZE);
+}
+
+static inline float cos_fast(float x)
+{
+    float t = x * (float)(COS_LUT_SIZE / (2.0 * M_PI));
+    int   i = (int)t - (t < 0.0f);   /* floor */
+    float f = t - (float)i;
+    const float *p = cos_lut + (i & (COS_LUT_SIZE - 1));
+    return p[0] + f * (p[1] - p[0]);
+}
+
+/*
+ * Unrotated ray directions (nx, ny, RAY_NZ), built once per resolution.
+ * The pixel-to-direction mapping is separable, so the table holds nx
+ * per column and ny per row rather than a pair per pixel.  Both arrays
+ * are 32-byte aligned and padded to a multiple of 8 entries (the padding
+ * continues the mapping), so render_rows_avx2 loads 8 columns at once.
+ */
+static float *ray_nx, *ray_ny;
+
+static int init_ray_table(int W, int H)
+{
+    size_t wn = ((size_t)W + 7) & ~(size_t)7;
+    size_t hn = ((size_t)H + 7) & ~(size_t)7;
+
+    ray_nx = (float *)aligned_alloc(32, wn * sizeof(float));
+    ray_ny = (float *)aligned_alloc(32, hn * sizeof(float));
+    if (!ray_nx || !ray_ny)
+        return -1;
+    for (size_t col = 0; col < wn; col++)
+        ray_nx[col] = ((col + 0.5f) / W * 320.0f - 160.0f) / EYE_VAL;
+    for (size_t row = 0; row < hn; row++)
+        ray_ny[row] = ((row + 0.5f) / H * 200.0f - 100.0f) / EYE_VAL;
+    return 0;
+}
+
+/*
+ * March budget and hit threshold (--steps, --epsilon), as in
+ * lattice_big: a ray that hits after k steps is darkened to 2 * (32 - k)
+ * (clamped at 0) whatever the budget, so the budget only decides which
+ * rays miss.
+ */
+#define MAX_STEPS 255
+
+static int     march_steps = 32;
+static float   march_eps   = EPSILON;
+static uint8_t bright_lut[MAX_STEPS + 1 + 3];   /* +3: 32-bit gathers */
+
+static void set_march(int steps, float eps)
+{
+    march_steps = steps;
+    march_eps   = eps;
+    for (int s = 0; s <= MAX_STEPS; s++)
+        bright_lut[s] = (uint8_t)(s == 0 || s > steps || s + 32 <= steps
+                                  ? 0 : 2 * (s + 32 - steps));
+}
+
+/*
+ * --reproject: temporal seeding of the sphere tracer.  While marching,
+ * each ray records a checkpoint: the last step it reached at or before
+ * `frac` of its final distance, with the step index it got there at.
+ * Before the next frame, reproject_seeds() moves every checkpoint into
+ * the new camera and splats it onto the pixel whose ray passes through
+ * it, keeping the nearest one.  The kernel then starts that pixel's ray
+ * at the seed, counting steps from the seed's index so the step-based
+ * brightness is unchanged.  A seed whose first SDF sample already
+ * reports a hit may lie inside the surface and is thrown away for a full
+ * march from the camera; pixels no checkpoint lands on march in full.
+ */
+#define REPROJ_NONE 0xFF
+
+typedef struct {
+    float     frac;
+    float    *ck_t;          /* per pixel, written by the kernel */
+    uint8_t  *ck_step;
+    float    *seed_t;        /* per pixel, read by the kernel */
+    uint8_t  *seed_step;     /* REPROJ_NONE: march from the camera */
+    uint32_t *row_rejected;  /* per row: seeds thrown away */
+    int       have_prev;
+    float     rot[3][3];     /* camera of the checkpoints */
+    double    zmove;
+} reproj_t;
+
+/*
+ * --subsample: edge-aware adaptive sampling.  The workers first trace
+ * every nth pixel of every nth row (plus the last column and row), wait
+ * for each other, then visit each n x n cell: if its four corner samples
+ * agree within t_steps in steps_left and t_uv texels in u and v, the
+ * interior palette indices are interpolated bilinearly from the
+ * corners, otherwise every interior pixel is traced.
+ */
+typedef struct {
+    int       n;
+    int       t_steps, t_uv;
+    int       fast_cos;
+    uint8_t  *steps;         /* per pixel, valid at traced pixels */
+    uint8_t  *u, *v;
+    uint32_t *row_traced;    /* per row: rays traced this frame */
+} subsample_t;
+
+/*
+ * --cone: cone marching over screen tiles.  Every pixel ray of an NxN
+ * tile lies within `spread` of the ray through the tile centre (the
+ * rotations preserve distances, so that is measured on the unrotated
+ * directions); at parameter t the rays are at most spread * t apart.
+ * The SDF's gradient (-sin x, -sin y, -sin z) is bounded by sqrt 3, so
+ * while sdf(centre) - sqrt 3 * spread * t stays at or above march_eps no
+ * ray of the tile can register a hit.  The centre ray marches under that
+ * test and every ray of the tile continues from where it stopped, with
+ * the cone's step count.
+ */
+typedef struct {
+    int      n;
+    uint8_t *tile_steps;     /* per tile: steps taken by the cone */
+} cone_t;
+
+typedef struct {
+    float t;
+    int   steps;
+} cone_hit_t;
+
+/*
+ * --simd-shade: shading as a separate stage.  The marcher leaves a row's
+ * hit points and step counts in a hit_row_t (one array per field) and
+ * the stage turns the whole row into pixbuf bytes, so shade_row_avx2 can
+ * do the atan2, the two roundings and the texel loads 8 pixels at a time.
+ */
+typedef struct {
+    float   *x, *y, *z;
+    int32_t *steps_left;
+} hit_row_t;
+
+typedef void (*shade_row_fn)(uint8_t *dst, const hit_row_t *hits, int n,
+                             float v_phase);
+
 /* Per-frame constants shared by all threads (read-only during render) */
 typedef struct {
     int       W, H;
     uint8_t  *pixbuf;
-    float     cosa, sina;
-    float     cam_z;
+    uint8_t  *steps;       /* optional: steps_left per pixel */
+    uint32_t *row_steps;   /* optional: SDF evaluations per row */
+    uint8_t  *pix_steps;   /* optional: SDF evaluations per pixel */
+    uint64_t *row_ns;      /* optional: time per row, on row_clock */
+    clockid_t row_clock;   /* CLOCK_MONOTONIC, or thread CPU time (--balance) */
+    int      *row_split;   /* --balance: first row of each band, or NULL */
+    reproj_t *rp;          /* --reproject state, or NULL */
+    subsample_t *sub;      /* --subsample state, or NULL */
+    cone_t   *cone;        /* --cone state, or NULL */
+    shade_row_fn shade;    /* --simd-shade stage, or NULL: shade per pixel */
+    float     relax;       /* --relax factor, 1 = plain sphere tracing */
+    float     rot[3][3];   /* (nx, ny, nz) -> step along posX, posY, posZ */
+    float     cam_z;       /* reduced to [0, 2 pi) */
+    float     v_phase;     /* texture v offset of the dropped periods */
     int       quit;
 } frame_params_t;
 
+/*
+ * The original rotates each ray twice by the same angle: (nx, ny) into
+ * (x1, y1), then (nz, x1) into (rx, rz); y1 steps posX, rx posY and rz
+ * posZ.  Both rotations fold into one orthogonal matrix per frame,
+ * worked out in double and rounded once; its transpose undoes it.
+ */
+static void camera_rotation(frame_params_t *fp, double c, double s)
+{
+    fp->rot[0][0] = (float)-s;
+    fp->rot[0][1] = (float)c;
+    fp->rot[0][2] = 0.0f;
+    fp->rot[1][0] = (float)(c * c);
+    fp->rot[1][1] = (float)(s * c);
+    fp->rot[1][2] = (float)s;
+    fp->rot[2][0] = (float)(-c * s);
+    fp->rot[2][1] = (float)(-s * s);
+    fp->rot[2][2] = (float)c;
+}
+
+/*
+ * Camera state for frame position zmove.  zmove runs down without bound,
+ * so it is kept in double and reduced here, outside the pixel loop: the
+ * rotation angle modulo 2 pi, and the camera Z modulo the 2 pi period of
+ * the SDF.  Dropping k periods from Z shifts the texture v coordinate by
+ * k * 2 pi * UV_SCALE texels, carried modulo 256 in v_phase.  Rays start
+ * within one period of the origin and march at most MAX_STEPS, so cosf
+ * only ever sees small arguments, however long the program has run.
+ */
+static void camera_state(frame_params_t *fp, double zmove)
+{
+    double angle = fmod(zmove / 41.0, 2.0 * M_PI);
+    double z = zmove / M_PI;
+    double k = floor(z / (2.0 * M_PI));
+
+    camera_rotation(fp, cos(angle), sin(angle));
+    fp->cam_z   = (float)(z - k * 2.0 * M_PI);
+    fp->v_phase = (float)fmod(k * 2.0 * M_PI * UV_SCALE, 256.0);
+}
+
+typedef void (*render_rows_fn)(const frame_params_t *fp, int row_begin,
+                               int row_end);
+
 typedef struct {
     int               id;
     int               nthreads;
     frame_params_t   *fp;
+    render_rows_fn    render;
     pthread_barrier_t *bar_start;
+    pthread_barrier_t *bar_mid;    /* --subsample: between the two passes */
     pthread_barrier_t *bar_done;
+    uint64_t          done_ns;     /* CLOCK_MONOTONIC on reaching bar_done */
 } worker_t;
 
-static void render_rows(const frame_params_t *fp, int row_begin, int row_end)
+/* Schwarz P surface: cos x + cos y + cos z + ln 2 */
+static inline __attribute__((always_inline)) float
+lattice_sdf(float x, float y, float z, int fast_cos)
 {
-    int W = fp->W;
-    int H = fp->H;
-    float cosa  = fp->cosa;
-    float sina  = fp->sina;
+    return fast_cos
+         ? cos_fast(z) + cos_fast(y) + cos_fast(x) + 0.69314718f
+         : cosf(z) + cosf(y) + cosf(x) + 0.69314718f;
+}
+
+/* Ray direction of unrotated direction (nx, ny, RAY_NZ), in the order
+ * posX/posY/posZ use it.  The ny and nz terms are grouped so a row loop
+ * hoists them, leaving one multiply-add per component per pixel. */
+static inline __attribute__((always_inline)) void
+lattice_ray(const frame_params_t *fp, float nx, float ny,
+            float *ry, float *rx, float *rz)
+{
+    const float (*m)[3] = fp->rot;
+
+    *ry = m[0][0] * nx + (m[0][1] * ny + m[0][2] * RAY_NZ);
+    *rx = m[1][0] * nx + (m[1][1] * ny + m[1][2] * RAY_NZ);
+    *rz = m[2][0] * nx + (m[2][1] * ny + m[2][2] * RAY_NZ);
+}
+
+/* Texel at the hit point darkened by the steps taken; u/v for --subsample */
+static inline __attribute__((always_inline)) uint8_t
+lattice_shade(float posX, float posY, float posZ, int steps_left,
+              float v_phase, uint8_t *u, uint8_t *v)
+{
+    int u_i = (int)lrintf(atan2f(posY, posX) * UV_SCALE);
+    int v_i = (int)lrintf(posZ * UV_SCALE + v_phase);
+    uint16_t uv = (uint16_t)(((v_i & 0xFF) << 8) | (u_i & 0xFF));
+
+    uint8_t tex_val = texture[uv];
+    uint8_t neg_tex = (uint8_t)(-(int8_t)tex_val);
+    uint8_t bright  = bright_lut[steps_left];
+    uint16_t product = (uint16_t)neg_tex * (uint16_t)bright;
+
+    *u = (uint8_t)u_i;
+    *v = (uint8_t)v_i;
+    return (uint8_t)(product >> 8);
+}
+
+static void shade_row_scalar(uint8_t *dst, const hit_row_t *hits, int n,
+                             float v_phase)
+{
+    for (int i = 0; i < n; i++) {
+        uint8_t u, v;
+        dst[i] = lattice_shade(hits->x[i], hits->y[i], hits->z[i],
+                               hits->steps_left[i], v_phase, &u, &v);
+    }
+}
+
+/* Row buffers for W pixels, rounded up so 8-wide stores stay inside */
+static int hit_row_alloc(hit_row_t *hits, int W)
+{
+    size_t n = ((size_t)W + 7) & ~(size_t)7;
+    float *p = (float *)malloc(sizeof(float) * 4 * n);
+    if (!p)
+        return -1;
+    hits->x = p;
+    hits->y = p + n;
+    hits->z = p + 2 * n;
+    hits->steps_left = (int32_t *)(p + 3 * n);
+    return 0;
+}
+
+/* March the bounding cone of the tile with pixel corners (x0, y0) and
+ * (x1, y1); returns the SDF evaluations spent */
+static inline __attribute__((always_inline)) uint32_t
+cone_march(const frame_params_t *fp, int W, int H, int x0, int y0, int x1,
+           int y1, int fast_cos, cone_hit_t *hit)
+{
+    float fx = 0.5f * (x0 + x1), fy = 0.5f * (y0 + y1);
+    float rx, ry, rz;
+    lattice_ray(fp, ((fx + 0.5f) / W * 320.0f - 160.0f) / EYE_VAL,
+                ((fy + 0.5f) / H * 200.0f - 100.0f) / EYE_VAL, &ry, &rx, &rz);
+
+    /* Farthest corner from the centre, in unrotated direction space */
+    float dx = 0.5f * (x1 - x0 + 1) / W * 320.0f / EYE_VAL;
+    float dy = 0.5f * (y1 - y0 + 1) / H * 200.0f / EYE_VAL;
+    float margin = 1.7320508f * sqrtf(dx * dx + dy * dy);
+
+    float posX = 0.0f, posY = 0.0f, posZ = fp->cam_z, t = 0.0f;
+    float eps = march_eps;
+    int   step = 0, max_steps = march_steps - 1;
+    uint32_t evals = 0;
+
+    for (; step < max_steps; step++) {
+        float sdf = lattice_sdf(posX, posY, posZ, fast_cos);
+        evals++;
+        if (sdf - margin * t < eps)
+            break;
+        posX += sdf * ry;
+        posY += sdf * rx;
+        posZ += sdf * rz;
+        t += sdf;
+    }
+    hit->t = t;
+    hit->steps = step;
+    return evals;
+}
+
+static inline uint64_t now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline __attribute__((always_inline)) void
+render_rows_kernel(const frame_params_t *fp, int row_begin, int row_end,
+                   int fast_cos, int reproj, int cone, int relax)
+{
+    int W = fp->W, H = fp->H;
     float cam_z = fp->cam_z;
+    float v_phase = fp->v_phase;
     uint8_t *pixbuf = fp->pixbuf;
+    reproj_t *rp = fp->rp;
+    int   max_steps = march_steps;
+    float eps = march_eps;
+    int n = cone ? fp->cone->n : 1;
+    cone_hit_t *tiles = NULL;
+    shade_row_fn shade = fp->shade;
+    hit_row_t hits = { 0 };
 
-    for (int row = row_begin; row < row_end; row++) {
-        float py_f = (row + 0.5f) / H * 200.0f - 100.0f;
-        for (int col = 0; col < W; col++) {
-            float px_f = (col + 0.5f) / W * 320.0f - 160.0f;
+    if (shade && hit_row_alloc(&hits, W) < 0)
+        shade = NULL;
+    if (cone) {
+        tiles = (cone_hit_t *)malloc(sizeof(cone_hit_t) * ((W + n - 1) / n));
+        if (!tiles)
+            cone = 0;
+    }
 
-            float nx = px_f / EYE_VAL;
-            float ny = py_f / EYE_VAL;
-            float nz = 0.30102999566f;  /* log10(2) */
+    for (int row = row_begin; row < row_end; row++) {
+        uint32_t evals = 0, rejected = 0;
+        uint64_t t_row = fp->row_ns ? now_ns(fp->row_clock) : 0;
 
-            /* First rotation: (nx, ny) plane */
-            float x1 = nx * cosa + ny * sina;
-            float y1 = ny * cosa - nx * sina;
+        if (cone && (row == row_begin || row % n == 0)) {
+            /* Cones of this tile row; the band holding a tile's first
+             * row owns its statistics */
+            int y0 = row / n * n;
+            int y1 = y0 + n - 1 < H - 1 ? y0 + n - 1 : H - 1;
+            for (int tx = 0; tx * n < W; tx++) {
+                int x0 = tx * n;
+                int x1 = x0 + n - 1 < W - 1 ? x0 + n - 1 : W - 1;
+                uint32_t e = cone_march(fp, W, H, x0, y0, x1, y1, fast_cos,
+                                        &tiles[tx]);
+                if (y0 == row) {
+                    evals += e;
+                    fp->cone->tile_steps[(size_t)(y0 / n) * ((W + n - 1) / n) + tx] =
+                        (uint8_t)tiles[tx].steps;
+                }
+            }
+        }
 
-            /* Second rotation: (nz, x1) plane */
-            float rx = x1 * cosa + nz * sina;
-            float rz = nz * cosa - x1 * sina;
-            float ry = y1;
+        for (int col = 0; col < W; col++) {
+            float rx, ry, rz;
+            lattice_ray(fp, ray_nx[col], ray_ny[row], &ry, &rx, &rz);
 
             float posX = 0.0f;
             float posY = 0.0f;
             float posZ = cam_z;
             int   steps_left = 0;
+            int   step = 0, start = 0;
+            float t = 0.0f, t_at[MAX_STEPS + 1];
+            uint32_t evals_px = evals;
+            float omega = fp->relax, prev_r = 0.0f, step_len = 0.0f;
 
-            for (int step = 0; step < 32; step++) {
-                float sdf = cosf(posZ) + cosf(posY) + cosf(posX)
-                          + 0.69314718f;
-                int is_hit = (sdf < EPSILON);
+            if (reproj && rp->seed_step[row * W + col] != REPROJ_NONE) {
+                start = step = rp->seed_step[row * W + col];
+                t = rp->seed_t[row * W + col];
+                posX = t * ry;
+                posY = t * rx;
+                posZ = cam_z + t * rz;
+            } else if (cone) {
+                start = step = tiles[col / n].steps;
+                t = tiles[col / n].t;
+                posX = t * ry;
+                posY = t * rx;
+                posZ = cam_z + t * rz;
+            }
+
+            for (; step < max_steps; step++) {
+                float sdf = lattice_sdf(posX, posY, posZ, fast_cos);
+                int is_hit = (sdf < eps);
+                evals++;
+
+                if (reproj && is_hit && step == start && start > 0) {
+                    /* Seed may be past the surface: march in full */
+                    rejected++;
+                    start = 0;
+                    step = -1;
+                    t = 0.0f;
+                    posX = posY = 0.0f;
+                    posZ = cam_z;
+                    continue;
+                }
+
+                /*
+                 * --relax: over-relaxed sphere tracing (Keinert et al.,
+                 * "Enhanced Sphere Tracing").  A ray advances relax * sdf
+                 * per step.  Before trusting a step, the unbounded sphere
+                 * at the new point must overlap the previous one (|sdf| +
+                 * previous |sdf| >= step length); when it does not, the
+                 * step may have jumped a thin feature, so the ray backs up
+                 * to a point inside the previous sphere, skips the hit
+                 * test and finishes with plain steps.  The failed step
+                 * still counts as a step.
+                 */
+                if (relax) {
+                    float r = fabsf(sdf);
+                    if (omega > 1.0f && r + prev_r < step_len) {
+                        /* Back into the previous sphere, plain from here */
+                        step_len -= omega * step_len;
+                        omega = 1.0f;
+                        prev_r = r;
+                        t += step_len;
+                        posX += step_len * ry;
+                        posY += step_len * rx;
+                        posZ += step_len * rz;
+                        continue;
+                    }
+                    prev_r = r;
+                }
+
+                float adv = relax && !is_hit ? sdf * omega : sdf;
+                step_len = adv;
+                if (reproj)
+                    t_at[step] = t;
+                t += adv;
 
-                posX += sdf * ry;
-                posY += sdf * rx;
-                posZ += sdf * rz;
+                posX += adv * ry;
+                posY += adv * rx;
+                posZ += adv * rz;
 
                 if (is_hit) {
-                    steps_left = 32 - step;
+                    steps_left = max_steps - step;
                     break;
                 }
             }
 
-            int u_i = (int)lrintf(atan2f(posY, posX) * UV_SCALE);
-            int v_i = (int)lrintf(posZ * UV_SCALE);
-            uint16_t uv = (uint16_t)(((v_i & 0xFF) << 8) | (u_i & 0xFF));
+            if (reproj) {
+                /* No progress past the seed: march in full next frame,
+                 * so step indices do not drift along a chain of seeds */
+                int ck = 0;
+                for (int s = (step < max_steps ? step : max_steps - 1);
+                     s > start; s--) {
+                    if (t_at[s] <= rp->frac * t) {
+                        ck = s;
+                        break;
+                    }
+                }
+                rp->ck_t[row * W + col] = t_at[ck];
+                rp->ck_step[row * W + col] = (uint8_t)ck;
+            }
+
+            if (shade) {
+                hits.x[col] = posX;
+                hits.y[col] = posY;
+                hits.z[col] = posZ;
+                hits.steps_left[col] = steps_left;
+            } else {
+                uint8_t u, v;
+                pixbuf[row * W + col] =
+                    lattice_shade(posX, posY, posZ, steps_left, v_phase, &u, &v);
+            }
+            if (fp->steps)
+                fp->steps[row * W + col] = (uint8_t)steps_left;
+            if (fp->pix_steps)
+                fp->pix_steps[row * W + col] = (uint8_t)(evals - evals_px);
+        }
+        if (shade)
+            shade(pixbuf + row * W, &hits, W, v_phase);
+        if (fp->row_steps)
+            fp->row_steps[row] = evals;
+        if (reproj)
+            rp->row_rejected[row] = rejected;
+        if (fp->row_ns)
+            fp->row_ns[row] = now_ns(fp->row_clock) - t_row;
+    }
+    free(tiles);
+    free(hits.x);
+}
+
+/* Kernel instances: render_rows_kernel with its mode flags fixed */
+static void render_rows_scalar(const frame_params_t *fp, int row_begin,
+                                int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 0, 0, 0, 0);
+}
+
+static void render_rows_fast_cos(const frame_params_t *fp, int row_begin,
+                                 int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 1, 0, 0, 0);
+}
+
+static void render_rows_reproject(const frame_params_t *fp, int row_begin,
+                                  int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 0, 1, 0, 0);
+}
+
+static void render_rows_reproject_fast_cos(const frame_params_t *fp,
+                                           int row_begin, int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 1, 1, 0, 0);
+}
+
+static void render_rows_cone(const frame_params_t *fp, int row_begin,
+                             int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 0, 0, 1, 0);
+}
+
+static void render_rows_cone_fast_cos(const frame_params_t *fp,
+                                      int row_begin, int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 1, 0, 1, 0);
+}
+
+static void render_rows_relax(const frame_params_t *fp, int row_begin,
+                              int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 0, 0, 0, 1);
+}
+
+static void render_rows_relax_fast_cos(const frame_params_t *fp,
+                                       int row_begin, int row_end)
+{
+    render_rows_kernel(fp, row_begin, row_end, 1, 0, 0, 1);
+}
+
+/* Trace one pixel in full and record what --subsample compares */
+static inline __attribute__((always_inline)) uint32_t
+sub_trace(const frame_params_t *fp, int row, int col)
+{
+    const subsample_t *sub = fp->sub;
+    int W = fp->W;
+    float rx, ry, rz;
+    lattice_ray(fp, ray_nx[col], ray_ny[row], &ry, &rx, &rz);
+
+    float posX = 0.0f, posY = 0.0f, posZ = fp->cam_z;
+    int   steps_left = 0, max_steps = march_steps;
+    float eps = march_eps;
+    uint32_t evals = 0;
+
+    for (int step = 0; step < max_steps; step++) {
+        float sdf = lattice_sdf(posX, posY, posZ, sub->fast_cos);
+        int is_hit = (sdf < eps);
+        evals++;
+
+        posX += sdf * ry;
+        posY += sdf * rx;
+        posZ += sdf * rz;
+
+        if (is_hit) {
+            steps_left = max_steps - step;
+            break;
+        }
+    }
+
+    size_t i = (size_t)row * W + col;
+    fp->pixbuf[i] = lattice_shade(posX, posY, posZ, steps_left, fp->v_phase,
+                                  &sub->u[i], &sub->v[i]);
+    sub->steps[i] = (uint8_t)steps_left;
+    if (fp->steps)
+        fp->steps[i] = (uint8_t)steps_left;
+    if (fp->pix_steps)
+        fp->pix_steps[i] = (uint8_t)evals;
+    return evals;
+}
+
+static inline int sub_is_grid(int x, int n, int last)
+{
+    return x % n == 0 || x == last;
+}
+
+/* Pass 1: the grid samples in rows [row_begin, row_end) */
+static void sub_trace_grid(const frame_params_t *fp, int row_begin, int row_end)
+{
+    const subsample_t *sub = fp->sub;
+    int W = fp->W, n = sub->n;
+
+    for (int row = row_begin; row < row_end; row++) {
+        uint32_t evals = 0, traced = 0;
+        uint64_t t_row = fp->row_ns ? now_ns(fp->row_clock) : 0;
+        if (sub_is_grid(row, n, fp->H - 1)) {
+            for (int col = 0; col < W; col++) {
+                if (sub_is_grid(col, n, W - 1)) {
+                    evals += sub_trace(fp, row, col);
+                    traced++;
+                }
+            }
+        }
+        sub->row_traced[row] = traced;
+        if (fp->row_steps)
+            fp->row_steps[row] = evals;
+        if (fp->row_ns)
+            fp->row_ns[row] = now_ns(fp->row_clock) - t_row;
+    }
+}
+
+/* Do the samples at a and b disagree beyond the thresholds? */
+static inline int sub_differ(const subsample_t *sub, size_t a, size_t b)
+{
+    return abs(sub->steps[a] - sub->steps[b]) > sub->t_steps ||
+           abs((int8_t)(sub->u[a] - sub->u[b])) > sub->t_uv ||
+           abs((int8_t)(sub->v[a] - sub->v[b])) > sub->t_uv;
+}
+
+/* Pass 2: every other pixel of rows [row_begin, row_end), once all grid
+ * samples of the frame are in */
+static void sub_fill(const frame_params_t *fp, int row_begin, int row_end)
+{
+    const subsample_t *sub = fp->sub;
+    int W = fp->W, H = fp->H, n = sub->n;
+    uint8_t *pixbuf = fp->pixbuf;
+
+    for (int row = row_begin; row < row_end; row++) {
+        int y0 = row / n * n;
+        int y1 = y0 + n < H - 1 ? y0 + n : H - 1;
+        int wy = y1 > y0 ? (row - y0) * 256 / (y1 - y0) : 0;
+        uint32_t evals = 0, traced = 0;
+        uint64_t t_row = fp->row_ns ? now_ns(fp->row_clock) : 0;
+
+        for (int x0 = 0; x0 < W - 1; x0 += n) {
+            int x1 = x0 + n < W - 1 ? x0 + n : W - 1;
+            size_t c00 = (size_t)y0 * W + x0, c01 = (size_t)y0 * W + x1;
+            size_t c10 = (size_t)y1 * W + x0, c11 = (size_t)y1 * W + x1;
+            int edge = sub_differ(sub, c00, c01) || sub_differ(sub, c00, c10) ||
+                       sub_differ(sub, c00, c11) || sub_differ(sub, c01, c10) ||
+                       sub_differ(sub, c01, c11) || sub_differ(sub, c10, c11);
+
+            /* Columns x0 .. x1 - 1; the last cell also owns x1 */
+            int xe = x1 == W - 1 ? x1 : x1 - 1;
+            for (int col = x0; col <= xe; col++) {
+                if (sub_is_grid(row, n, H - 1) && sub_is_grid(col, n, W - 1))
+                    continue;
+                if (edge) {
+                    evals += sub_trace(fp, row, col);
+                    traced++;
+                } else {
+                    int wx = (col - x0) * 256 / (x1 - x0);
+                    int top = pixbuf[c00] * (256 - wx) + pixbuf[c01] * wx;
+                    int bot = pixbuf[c10] * (256 - wx) + pixbuf[c11] * wx;
+                    pixbuf[(size_t)row * W + col] =
+                        (uint8_t)((top * (256 - wy) + bot * wy + 32768) >> 16);
+                    if (fp->pix_steps)
+                        fp->pix_steps[(size_t)row * W + col] = 0;
+                }
+            }
+        }
+        sub->row_traced[row] += traced;
+        if (fp->row_steps)
+            fp->row_steps[row] += evals;
+        if (fp->row_ns)
+            fp->row_ns[row] += now_ns(fp->row_clock) - t_row;
+    }
+}
+
+static int sub_alloc(subsample_t *sub, int W, int H, int n, int t_steps,
+                     int t_uv, int fast_cos)
+{
+    size_t px = (size_t)W * H;
+    sub->n          = n;
+    sub->t_steps    = t_steps;
+    sub->t_uv       = t_uv;
+    sub->fast_cos   = fast_cos;
+    sub->steps      = (uint8_t *)malloc(px);
+    sub->u          = (uint8_t *)malloc(px);
+    sub->v          = (uint8_t *)malloc(px);
+    sub->row_traced = (uint32_t *)calloc(H, sizeof(uint32_t));
+    return sub->steps && sub->u && sub->v && sub->row_traced ? 0 : -1;
+}
+
+static void sub_free(subsample_t *sub)
+{
+    free(sub->steps);
+    free(sub->u);
+    free(sub->v);
+    free(sub->row_traced);
+}
+
+#ifdef HAVE_AVX2_KERNEL
+
+/*
+ * 8-wide AVX2 sphere tracer.  Compiled with a target attribute so the
+ * rest of the file keeps the baseline ISA; main() only selects it after
+ * a runtime CPU check.  FMA is deliberately not enabled so the ray setup
+ * and the position updates round exactly like the scalar code; only the
+ * cosine differs from libm.
+ */
+#define AVX2_FN __attribute__((target("avx2")))
+
+/* cos(x): quadrant reduction by pi/2 in three parts (exact for |x| < 2^15)
+ * and the minimax sin/cos polynomials on [-pi/4, pi/4] from Cephes sinf,
+ * within ~1 ulp of cosf over the range the marcher visits */
+AVX2_FN static inline __m256 cos_avx2(__m256 x)
+{
+    __m256  jf = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.63661977f)),
+                                 _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256i j  = _mm256_cvtps_epi32(jf);
+
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(jf, _mm256_set1_ps(1.5703125f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(4.837512969970703125e-4f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(7.54978995489188216e-8f)));
+    __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 c = _mm256_set1_ps(2.443315711809948e-5f);
+    c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(-1.388731625493765e-3f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(4.166664568298827e-2f));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+    c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))),
+                      _mm256_set1_ps(1.0f));
+
+    __m256 s = _mm256_set1_ps(-1.9515295891e-4f);
+    s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(8.3321608736e-3f));
+    s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(-1.6666654611e-1f));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), r), r);
+
+    /* quadrant j: cos, -sin, -cos, sin */
+    __m256 odd = _mm256_castsi256_ps(_mm256_slli_epi32(j, 31));
+    __m256 neg = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_add_epi32(j, _mm256_set1_epi32(1)), 30));
+    __m256 v = _mm256_blendv_ps(c, s, odd);
+    return _mm256_xor_ps(v, _mm256_and_ps(neg, _mm256_set1_ps(-0.0f)));
+}
+
+AVX2_FN static void render_rows_avx2(const frame_params_t *fp, int row_begin,
+                                     int row_end)
+{
+    int W = fp->W;
+    uint8_t *pixbuf = fp->pixbuf;
+
+    const float (*m)[3] = fp->rot;
+    const __m256 m00   = _mm256_set1_ps(m[0][0]);
+    const __m256 m10   = _mm256_set1_ps(m[1][0]);
+    const __m256 m20   = _mm256_set1_ps(m[2][0]);
+    const __m256 eps   = _mm256_set1_ps(march_eps);
+    const int    max_steps = march_steps;
+    const __m256 ln2   = _mm256_set1_ps(0.69314718f);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    shade_row_fn shade = fp->shade ? fp->shade : shade_row_scalar;
+    hit_row_t hits;
+
+    if (hit_row_alloc(&hits, W) < 0)
+        return;
+
+    for (int row = row_begin; row < row_end; row++) {
+        /* The ny and nz terms of the rotation are constant along a row */
+        float ny = ray_ny[row];
+        __m256 by = _mm256_set1_ps(m[0][1] * ny + m[0][2] * RAY_NZ);
+        __m256 bx = _mm256_set1_ps(m[1][1] * ny + m[1][2] * RAY_NZ);
+        __m256 bz = _mm256_set1_ps(m[2][1] * ny + m[2][2] * RAY_NZ);
+        uint32_t evals = 0;
+        uint64_t t_row = fp->row_ns ? now_ns(fp->row_clock) : 0;
+
+        for (int col = 0; col < W; col += 8) {
+            __m256 nx = _mm256_load_ps(ray_nx + col);
+            __m256 ry = _mm256_add_ps(_mm256_mul_ps(m00, nx), by);
+            __m256 rx = _mm256_add_ps(_mm256_mul_ps(m10, nx), bx);
+            __m256 rz = _mm256_add_ps(_mm256_mul_ps(m20, nx), bz);
+
+            __m256  posX = _mm256_setzero_ps();
+            __m256  posY = _mm256_setzero_ps();
+            __m256  posZ = _mm256_set1_ps(fp->cam_z);
+            /* Lanes past the end of the row start dead: they are neither
+             * marched nor counted */
+            __m256  live = _mm256_castsi256_ps(
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(W - col), lane));
+            __m256i steps_left = _mm256_setzero_si256();
+            __m256i lane_evals = _mm256_setzero_si256();
+
+            /* All lanes advance in lockstep; a lane that hits takes its
+             * final step like the scalar loop and is then frozen */
+            for (int step = 0; step < max_steps; step++) {
+                __m256 sdf = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_add_ps(cos_avx2(posZ), cos_avx2(posY)),
+                                  cos_avx2(posX)),
+                    ln2);
+                __m256 is_hit = _mm256_and_ps(_mm256_cmp_ps(sdf, eps, _CMP_LT_OQ), live);
+                evals += __builtin_popcount(_mm256_movemask_ps(live));
+                lane_evals = _mm256_sub_epi32(lane_evals, _mm256_castps_si256(live));
+
+                sdf  = _mm256_and_ps(sdf, live);
+                posX = _mm256_add_ps(posX, _mm256_mul_ps(sdf, ry));
+                posY = _mm256_add_ps(posY, _mm256_mul_ps(sdf, rx));
+                posZ = _mm256_add_ps(posZ, _mm256_mul_ps(sdf, rz));
+
+                steps_left = _mm256_blendv_epi8(steps_left,
+                                                _mm256_set1_epi32(max_steps - step),
+                                                _mm256_castps_si256(is_hit));
+                live = _mm256_andnot_ps(is_hit, live);
+                if (_mm256_movemask_ps(live) == 0)
+                    break;
+            }
+
+            _mm256_storeu_ps(hits.x + col, posX);
+            _mm256_storeu_ps(hits.y + col, posY);
+            _mm256_storeu_ps(hits.z + col, posZ);
+            _mm256_storeu_si256((__m256i *)(hits.steps_left + col), steps_left);
+
+            if (fp->pix_steps) {
+                int32_t e[8];
+                _mm256_storeu_si256((__m256i *)e, lane_evals);
+                for (int i = 0; i < 8 && col + i < W; i++)
+                    fp->pix_steps[row * W + col + i] = (uint8_t)e[i];
+            }
+        }
+
+        shade(pixbuf + row * W, &hits, W, fp->v_phase);
+        if (fp->steps) {
+            for (int col = 0; col < W; col++)
+                fp->steps[row * W + col] = (uint8_t)hits.steps_left[col];
+        }
+        if (fp->row_steps)
+            fp->row_steps[row] = evals;
+        if (fp->row_ns)
+            fp->row_ns[row] = now_ns(fp->row_clock) - t_row;
+    }
+    free(hits.x);
+}
+
+/* atan2(y, x) via octant reduction and a degree-11 odd minimax polynomial
+ * for atan on [0, 1] (max error ~1e-5 rad, i.e. ~4e-4 texel at UV_SCALE) */
+AVX2_FN static inline __m256 atan2_avx2(__m256 y, __m256 x)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign, x);
+    __m256 ay = _mm256_andnot_ps(sign, y);
+    __m256 mx = _mm256_max_ps(ax, ay);
+    __m256 mn = _mm256_min_ps(ax, ay);
+    __m256 a  = _mm256_div_ps(mn, _mm256_max_ps(mx, _mm256_set1_ps(1e-30f)));
+    __m256 s  = _mm256_mul_ps(a, a);
+
+    __m256 r = _mm256_set1_ps(-0.01172120f);
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.05265332f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(-0.11643287f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.19354346f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(-0.33262347f));
+    r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps( 0.99997726f));
+    r = _mm256_mul_ps(r, a);
+
+    /* |y| > |x|: pi/2 - r;  x < 0: pi - r;  then take the sign of y */
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.57079637f), r),
+                         _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(3.14159274f), r), x);
+    return _mm256_or_ps(r, _mm256_and_ps(sign, y));
+}
+
+/*
+ * Vector shading stage: lattice_shade for 8 pixels.  The roundings are
+ * cvtps (nearest-even, like lrintf) and the texels come from a 32-bit
+ * gather; only the polynomial atan2 differs from the scalar stage.
+ */
+AVX2_FN static void shade_row_avx2(uint8_t *dst, const hit_row_t *hits, int n,
+                                   float v_phase)
+{
+    const __m256  scale = _mm256_set1_ps((float)UV_SCALE);
+    const __m256  phase = _mm256_set1_ps(v_phase);
+    const __m256i m8    = _mm256_set1_epi32(0xFF);
+    const __m256i lo4   = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(hits->x + i);
+        __m256 y = _mm256_loadu_ps(hits->y + i);
+        __m256 z = _mm256_loadu_ps(hits->z + i);
+        __m256i sl = _mm256_loadu_si256((const __m256i *)(hits->steps_left + i));
+
+        __m256i u_i = _mm256_cvtps_epi32(_mm256_mul_ps(atan2_avx2(y, x), scale));
+        __m256i v_i = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(z, scale), phase));
+        __m256i uv  = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(v_i, m8), 8),
+                                      _mm256_and_si256(u_i, m8));
+
+        /* (uint8_t)-texel * bright_lut[steps_left] >> 8 */
+        __m256i tex = _mm256_and_si256(
+            _mm256_i32gather_epi32((const int *)texture, uv, 1), m8);
+        __m256i neg = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), tex), m8);
+        __m256i bright = _mm256_and_si256(
+            _mm256_i32gather_epi32((const int *)bright_lut, sl, 1), m8);
+        __m256i pix = _mm256_srli_epi32(_mm256_mullo_epi32(neg, bright), 8);
+
+        /* Low byte of each lane */
+        pix = _mm256_shuffle_epi8(pix, lo4);
+        uint64_t packed = (uint32_t)_mm256_extract_epi32(pix, 0)
+                        | ((uint64_t)(uint32_t)_mm256_extract_epi32(pix, 4) << 32);
+        memcpy(dst + i, &packed, 8);
+    }
+
+    hit_row_t tail = {
+        hits->x + i, hits->y + i, hits->z + i, hits->steps_left + i
+    };
+    shade_row_scalar(dst + i, &tail, n - i, v_phase);
+}
+
+static int have_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+static int have_avx2(void)
+{
+    return 0;
+}
+
+#endif /* HAVE_AVX2_KERNEL */
+
+static int reproj_alloc(reproj_t *rp, int W, int H, float frac)
+{
+    size_t n = (size_t)W * H;
+    memset(rp, 0, sizeof(*rp));
+    rp->frac         = frac;
+    rp->ck_t         = (float *)malloc(sizeof(float) * n);
+    rp->ck_step      = (uint8_t *)malloc(n);
+    rp->seed_t       = (float *)malloc(sizeof(float) * n);
+    rp->seed_step    = (uint8_t *)malloc(n);
+    rp->row_rejected = (uint32_t *)calloc(H, sizeof(uint32_t));
+    if (!rp->ck_t || !rp->ck_step || !rp->seed_t || !rp->seed_step ||
+        !rp->row_rejected)
+        return -1;
+    return 0;
+}
+
+static void reproj_free(reproj_t *rp)
+{
+    free(rp->ck_t);
+    free(rp->ck_step);
+    free(rp->seed_t);
+    free(rp->seed_step);
+    free(rp->row_rejected);
+}
+
+/*
+ * Move the checkpoints of the last frame into the camera of *fp (at
+ * zmove) and splat each onto the nearest pixel, keeping the closest
+ * seed.  Runs on the main thread between frames; it is one projection
+ * per pixel against up to march_steps SDF steps in the kernel.
+ */
+static void reproject_seeds(reproj_t *rp, const frame_params_t *fp,
+                            double zmove)
+{
+    int W = fp->W, H = fp->H;
+    const float (*pm)[3] = rp->rot, (*m)[3] = fp->rot;
+
+    memset(rp->seed_step, REPROJ_NONE, (size_t)W * H);
+
+    if (rp->have_prev) {
+        /* camera Z of the old frame relative to the new one */
+        float dz = (float)((rp->zmove - zmove) / M_PI);
+
+        for (int row = 0; row < H; row++) {
+            for (int col = 0; col < W; col++) {
+                size_t i = (size_t)row * W + col;
+                if (rp->ck_step[i] == 0)
+                    continue;
+
+                /* Checkpoint relative to the new camera */
+                float nx = ray_nx[col], ny = ray_ny[row];
+                float t  = rp->ck_t[i];
+                float vX = t * (pm[0][0] * nx + pm[0][1] * ny + pm[0][2] * RAY_NZ);
+                float vY = t * (pm[1][0] * nx + pm[1][1] * ny + pm[1][2] * RAY_NZ);
+                float vZ = t * (pm[2][0] * nx + pm[2][1] * ny + pm[2][2] * RAY_NZ) + dz;
+
+                /* Undo the new camera's rotation with its transpose;
+                 * nz fixes the scale */
+                float tn = (m[0][2] * vX + m[1][2] * vY + m[2][2] * vZ) / RAY_NZ;
+                if (tn <= 0.0f)
+                    continue;
+                float qnx = (m[0][0] * vX + m[1][0] * vY + m[2][0] * vZ) / tn;
+                float qny = (m[0][1] * vX + m[1][1] * vY + m[2][1] * vZ) / tn;
+
+                int qc = (int)lrintf((qnx * EYE_VAL + 160.0f) / 320.0f * W - 0.5f);
+                int qr = (int)lrintf((qny * EYE_VAL + 100.0f) / 200.0f * H - 0.5f);
+                if (qc < 0 || qc >= W || qr < 0 || qr >= H)
+                    continue;
+
+                size_t j = (size_t)qr * W + qc;
+                if (rp->seed_step[j] == REPROJ_NONE || tn < rp->seed_t[j]) {
+                    rp->seed_t[j]    = tn;
+                    rp->seed_step[j] = rp->ck_step[i];
+                }
+            }
+        }
+    }
+
+    rp->have_prev = 1;
+    memcpy(rp->rot, fp->rot, sizeof(rp->rot));
+    rp->zmove = zmove;
+}
+
+static double sum_rows(const uint32_t *rows, int H)
+{
+    double s = 0.0;
+    for (int i = 0; i < H; i++)
+        s += rows[i];
+    return s;
+}
+
+/* --verify: render 100 frames at speed 1 through the scalar kernel and
+ * `render`, count the pixels where they differ, and the long rays (3/4
+ * of the step budget or more) in each */
+static int verify_mode(render_rows_fn render, const char *kernel, int W, int H,
+                       reproj_t *rp, subsample_t *sub, cone_t *cone,
+                       shade_row_fn shade, float relax)
+{
+    const int frames = 100;
+    size_t n = (size_t)W * H;
+    uint8_t  *a  = (uint8_t *)malloc(n);
+    uint8_t  *b  = (uint8_t *)malloc(n);
+    uint32_t *ra = (uint32_t *)malloc(sizeof(uint32_t) * H);
+    uint32_t *rb = (uint32_t *)malloc(sizeof(uint32_t) * H);
+    uint8_t  *pa = (uint8_t *)malloc(n);
+    uint8_t  *pb = (uint8_t *)malloc(n);
+    if (!a || !b || !ra || !rb || !pa || !pb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    double zmove = ZMOVE_INIT;
+    long  total = 0, worst = 0;
+    double steps_a = 0.0, steps_b = 0.0, traced = 0.0;
+    double long_a = 0.0, long_b = 0.0;
+    int    long_steps = (march_steps * 3 + 3) / 4;
+
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fa = {
+            .W = W, .H = H, .pixbuf = a, .row_steps = ra, .pix_steps = pa,
+            .relax = 1.0f
+        };
+        camera_state(&fa, zmove);
+        frame_params_t fb = fa;
+        fb.pixbuf = b;
+        fb.row_steps = rb;
+        fb.pix_steps = pb;
+        fb.relax = relax;
+        fb.rp = rp;
+        fb.sub = sub;
+        fb.cone = cone;
+        fb.shade = shade;
+
+        render_rows_scalar(&fa, 0, H);
+        if (rp)
+            reproject_seeds(rp, &fb, zmove);
+        if (sub) {
+            sub_trace_grid(&fb, 0, H);
+            sub_fill(&fb, 0, H);
+            traced += sum_rows(sub->row_traced, H);
+        } else {
+            render(&fb, 0, H);
+        }
+        steps_a += sum_rows(ra, H);
+        steps_b += sum_rows(rb, H);
+
+        long diff = 0;
+        for (size_t i = 0; i < n; i++) {
+            diff += (a[i] != b[i]);
+            long_a += (pa[i] >= long_steps);
+            long_b += (pb[i] >= long_steps);
+        }
+        total += diff;
+        if (diff > worst) worst = diff;
+    }
+
+    printf("verify %dx%d, %s kernel vs scalar, %d frames: %ld of %zu pixels "
+           "differ per frame on average (%.4f%%), worst frame %ld\n",
+           W, H, kernel, frames, total / frames, n,
+           100.0 * total / ((double)frames * n), worst);
+    printf("avg steps/pixel: %.2f scalar, %.2f %s\n",
+           steps_a / ((double)frames * n), steps_b / ((double)frames * n), kernel);
+    printf("rays of %d+ steps: %.2f%% scalar, %.2f%% %s\n", long_steps,
+           100.0 * long_a / ((double)frames * n),
+           100.0 * long_b / ((double)frames * n), kernel);
+    if (sub)
+        printf("rays traced: %.1f%%\n", 100.0 * traced / ((double)frames * n));
+
+    free(pb);
+    free(pa);
+    free(rb);
+    free(ra);
+    free(b);
+    free(a);
+    return 0;
+}
+
+/* --steps-hist: render 100 frames at speed 1 with cosf and with the
+ * table, and print how often each steps_left value occurs in both */
+static int steps_hist_mode(int W, int H)
+{
+    const int frames = 100;
+    size_t n = (size_t)W * H;
+    uint8_t *pa = (uint8_t *)malloc(n), *pb = (uint8_t *)malloc(n);
+    uint8_t *sa = (uint8_t *)malloc(n), *sb = (uint8_t *)malloc(n);
+    if (!pa || !pb || !sa || !sb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    long hist[2][MAX_STEPS + 1] = { { 0 } };
+    long steps_diff = 0, pix_diff = 0;
+    double zmove = ZMOVE_INIT;
 
-            uint8_t tex_val = texture[uv];
-            uint8_t neg_tex = (uint8_t)(-(int8_t)tex_val);
-            uint8_t bright  = (uint8_t)(steps_left * 2);
-            uint16_t product = (uint16_t)neg_tex * (uint16_t)bright;
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fa = {
+            .W = W, .H = H, .pixbuf = pa, .steps = sa
+        };
+        camera_state(&fa, zmove);
+        frame_params_t fb = fa;
+        fb.pixbuf = pb;
+        fb.steps = sb;
 
-            pixbuf[row * W + col] = (uint8_t)(product >> 8);
+        render_rows_scalar(&fa, 0, H);
+        render_rows_fast_cos(&fb, 0, H);
+
+        for (size_t i = 0; i < n; i++) {
+            hist[0][sa[i]]++;
+            hist[1][sb[i]]++;
+            steps_diff += (sa[i] != sb[i]);
+            pix_diff += (pa[i] != pb[i]);
         }
     }
+
+    printf("steps_left histogram, %dx%d, %d frames\n", W, H, frames);
+    printf("steps_left        cosf    fast-cos        diff\n");
+    for (int s = 0; s <= march_steps; s++) {
+        if (hist[0][s] || hist[1][s])
+            printf("%10d %11ld %11ld %+11ld\n",
+                   s, hist[0][s], hist[1][s], hist[1][s] - hist[0][s]);
+    }
+    printf("steps_left differs at %ld of %zu pixels (%.4f%%), "
+           "output at %ld (%.4f%%)\n",
+           steps_diff, n * frames, 100.0 * steps_diff / ((double)n * frames),
+           pix_diff, 100.0 * pix_diff / ((double)n * frames));
+
+    free(sb);
+    free(sa);
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+static int cone_alloc(cone_t *cone, int W, int H, int n)
+{
+    cone->n = n;
+    cone->tile_steps = (uint8_t *)calloc((size_t)((W + n - 1) / n) *
+                                         ((H + n - 1) / n), 1);
+    return cone->tile_steps ? 0 : -1;
+}
+
+/* --cone-stats: render 100 frames at speed 1 with and without --cone and
+ * report the SDF steps each tile saves, net of the cone's own steps */
+static int cone_stats_mode(render_rows_fn render, int W, int H, cone_t *cone)
+{
+    const int frames = 100;
+    int n = cone->n, tw = (W + n - 1) / n, th = (H + n - 1) / n;
+    size_t npx = (size_t)W * H;
+    uint8_t *pa = (uint8_t *)malloc(npx), *pb = (uint8_t *)malloc(npx);
+    uint8_t *sa = (uint8_t *)malloc(npx), *sb = (uint8_t *)malloc(npx);
+    if (!pa || !pb || !sa || !sb) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    double full = 0.0, saved = 0.0, saved_min = 1e30, saved_max = -1e30;
+    long   hist[10] = { 0 }, cone_hist[MAX_STEPS] = { 0 }, pix_diff = 0;
+    int    max_steps = march_steps;
+    double zmove = ZMOVE_INIT;
+
+    for (int f = 0; f < frames; f++) {
+        zmove -= 1.0;
+        frame_params_t fa = { .W = W, .H = H, .pixbuf = pa, .steps = sa };
+        camera_state(&fa, zmove);
+        frame_params_t fb = fa;
+        fb.pixbuf = pb;
+        fb.steps = sb;
+        fb.cone = cone;
+
+        render_rows_scalar(&fa, 0, H);
+        render(&fb, 0, H);
+
+        for (int ty = 0; ty < th; ty++) {
+            for (int tx = 0; tx < tw; tx++) {
+                int k = cone->tile_steps[(size_t)ty * tw + tx];
+                /* the cone's own steps */
+                double s = -(k < max_steps - 1 ? k + 1 : max_steps - 1);
+                int px = 0;
+                for (int y = ty * n; y < H && y < ty * n + n; y++) {
+                    for (int x = tx * n; x < W && x < tx * n + n; x++, px++) {
+                        size_t i = (size_t)y * W + x;
+                        int ea = sa[i] ? max_steps + 1 - sa[i] : max_steps;
+                        int eb = (sb[i] ? max_steps + 1 - sb[i] : max_steps) - k;
+                        full += ea;
+                        s += ea - eb;
+                        pix_diff += (pa[i] != pb[i]);
+                    }
+                }
+                saved += s;
+                if (s < saved_min) saved_min = s;
+                if (s > saved_max) saved_max = s;
+                int b = (int)(s / px);
+                hist[b < 0 ? 0 : b > 8 ? 9 : b + 1]++;
+                cone_hist[k]++;
+            }
+        }
+    }
+
+    long tiles = (long)tw * th * frames;
+    printf("cone stats %dx%d, %dx%d tiles, %d frames\n", W, H, n, n, frames);
+    printf("avg steps/pixel: %.2f full march, %.2f with cones (cone steps included)\n",
+           full / ((double)npx * frames), (full - saved) / ((double)npx * frames));
+    printf("steps saved per tile: %.1f average, %.0f .. %.0f\n",
+           saved / tiles, saved_min, saved_max);
+    printf("tiles by steps saved per pixel:\n");
+    for (int b = 0; b < 10; b++) {
+        if (!hist[b])
+            continue;
+        if (b == 0)
+            printf("  < 0 %11ld\n", hist[b]);
+        else if (b == 9)
+            printf("  >= 8 %10ld\n", hist[b]);
+        else
+            printf("  %d..%d %10ld\n", b - 1, b, hist[b]);
+    }
+    printf("tiles by cone steps:\n");
+    for (int k = 0; k < max_steps; k++)
+        if (cone_hist[k])
+            printf("  %2d %12ld\n", k, cone_hist[k]);
+    printf("output differs at %.4f%% of pixels\n",
+           100.0 * pix_diff / ((double)npx * frames));
+
+    free(sb);
+    free(sa);
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+/* First row of band b of nthreads; band nthreads starts at H */
+static inline int band_row(const frame_params_t *fp, int b, int nthreads)
+{
+    return fp->row_split ? fp->row_split[b] : b * fp->H / nthreads;
+}
+
+/*
+ * --balance: cost-guided row split.  Consecutive frames are nearly the
+ * same picture, so the CPU time each row took this frame predicts the
+ * next one.  The bands for the next frame are cut where the running sum
+ * of row times crosses each multiple of total / nthreads (at a row's
+ * midpoint), keeping every band at least one row.  Until a frame has
+ * been timed the split stays equal.
+ */
+static void balance_rows(frame_params_t *fp, int nthreads)
+{
+    int H = fp->H;
+    int *split = fp->row_split;
+    double total = 0.0;
+    for (int y = 0; y < H; y++)
+        total += fp->row_ns[y];
+    if (total <= 0.0)
+        return;
+
+    double acc = 0.0;
+    int y = 0;
+    split[0] = 0;
+    for (int b = 1; b < nthreads; b++) {
+        double target = total * b / nthreads;
+        while (y < H && acc + 0.5 * fp->row_ns[y] < target)
+            acc += fp->row_ns[y++];
+        int lo = split[b - 1] + 1, hi = H - (nthreads - b);
+        split[b] = y < lo ? lo : y > hi ? hi : y;
+    }
+    split[nthreads] = H;
 }
 
 static void *worker_func(void *arg)
@@ -170,30 +1436,395 @@ static void *worker_func(void *arg)
         if (w->fp->quit)
             break;
 
-        int H = w->fp->H;
-        int row_begin = w->id * H / w->nthreads;
-        int row_end   = (w->id + 1) * H / w->nthreads;
-        render_rows(w->fp, row_begin, row_end);
+        int row_begin = band_row(w->fp, w->id, w->nthreads);
+        int row_end   = band_row(w->fp, w->id + 1, w->nthreads);
+        if (w->fp->sub) {
+            sub_trace_grid(w->fp, row_begin, row_end);
+            pthread_barrier_wait(w->bar_mid);
+            sub_fill(w->fp, row_begin, row_end);
+        } else {
+            w->render(w->fp, row_begin, row_end);
+        }
 
+        w->done_ns = now_ns(CLOCK_MONOTONIC);
         pthread_barrier_wait(w->bar_done);
     }
 
     return NULL;
 }
 
+/* Run one frame on the worker pool */
+static void render_pool_frame(pthread_barrier_t *bar_start,
+                              pthread_barrier_t *bar_done)
+{
+    /* Release workers */
+    pthread_barrier_wait(bar_start);
+
+    /* Wait for all workers to finish rendering */
+    pthread_barrier_wait(bar_done);
+}
+
+/* Average SDF steps per pixel (and rejected seeds) since startup */
+static void report_steps(FILE *out, double steps, double rejected,
+                         long frames, int W, int H, const reproj_t *rp)
+{
+    double n = (double)frames * W * H;
+    if (frames <= 0)
+        return;
+    fprintf(out, "avg steps/pixel: %.2f", steps / n);
+    if (rp)
+        fprintf(out, ", %.2f%% of rays reseeded after a rejected seed",
+                100.0 * rejected / n);
+    fprintf(out, "\n");
+}
+
+/*
+ * --sweep: render `frames` frames of the default camera path on the
+ * worker pool at a grid of step budgets and hit thresholds.  Each frame
+ * is rendered untimed at 32 steps and EPSILON, then timed at the
+ * setting; print ms/frame against the share of pixels that differ, the
+ * mean palette-index difference where they do, and the share that
+ * moves by more than 4 of the 64 levels.  Settings marked * hold 25 fps.
+ */
+static int sweep_mode(frame_params_t *fp, const char *kernel, int nthreads,
+                      int frames, pthread_barrier_t *bar_start,
+                      pthread_barrier_t *bar_done)
+{
+    static const int   budgets[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+    static const float eps_scale[] = { 0.5f, 1.0f, 2.0f };
+    int W = fp->W, H = fp->H;
+    size_t n = (size_t)W * H;
+    uint8_t *pixbuf = fp->pixbuf;
+    uint8_t *pa = (uint8_t *)malloc(n), *pb = (uint8_t *)malloc(n);
+    if (!pa || !pb) {
+        fprintf(stderr, "Out of memory\n");
+        free(pa);
+        return 1;
+    }
+
+    printf("sweep %dx%d, %s kernel, %d threads, %d frames per setting\n",
+           W, H, kernel, nthreads, frames);
+    printf("%6s %9s %10s %7s %9s %9s %9s\n",
+           "steps", "epsilon", "ms/frame", "fps", "differ", "mean |d|", "|d| > 4");
+
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+        for (size_t e = 0; e < sizeof(eps_scale) / sizeof(eps_scale[0]); e++) {
+            float eps = EPSILON * eps_scale[e];
+            double zmove = ZMOVE_INIT, t = 0.0;
+            long diff = 0, absdiff = 0, visible = 0;
+
+            for (int f = 0; f < frames; f++) {
+                zmove -= 1.0;
+                camera_state(fp, zmove);
+
+                /* The workers are parked on bar_start between frames */
+                set_march(32, EPSILON);
+                fp->pixbuf = pa;
+                render_pool_frame(bar_start, bar_done);
+                set_march(budgets[b], eps);
+                fp->pixbuf = pb;
+
+                uint64_t t0 = now_ns(CLOCK_MONOTONIC);
+                render_pool_frame(bar_start, bar_done);
+                t += (now_ns(CLOCK_MONOTONIC) - t0) / 1e6;
+
+                for (size_t i = 0; i < n; i++) {
+                    int d = abs(pa[i] - pb[i]);
+                    diff += (d != 0);
+                    absdiff += d;
+                    visible += (d > 4);
+                }
+            }
+
+            double ms = t / frames;
+            printf("%6d %9.5f %10.2f %7.1f %8.2f%% %9.2f %8.2f%%%s\n",
+                   budgets[b], eps, ms, 1000.0 / ms,
+                   100.0 * diff / ((double)n * frames),
+                   diff ? (double)absdiff / diff : 0.0,
+                   100.0 * visible / ((double)n * frames),
+                   ms <= FRAME_MS ? " *" : "");
+        }
+    }
+    set_march(32, EPSILON);
+    fp->pixbuf = pixbuf;
+
+    free(pb);
+    free(pa);
+    return 0;
+}
+
+/* --subsample: fraction of rays traced per frame since startup */
+typedef struct {
+    double sum, min, max;
+    long   frames;
+} traced_stats_t;
+
+static void traced_add(traced_stats_t *ts, const subsample_t *sub, int W, int H)
+{
+    double f = sum_rows(sub->row_traced, H) / ((double)W * H);
+    if (ts->frames == 0 || f < ts->min) ts->min = f;
+    if (ts->frames == 0 || f > ts->max) ts->max = f;
+    ts->sum += f;
+    ts->frames++;
+}
+
+static void traced_report(FILE *out, const traced_stats_t *ts)
+{
+    if (ts->frames > 0)
+        fprintf(out, "rays traced per frame: %.1f%% average, %.1f%% .. %.1f%%\n",
+                100.0 * ts->sum / ts->frames, 100.0 * ts->min, 100.0 * ts->max);
+}
+
+/*
+ * --heatmap.  The overlay blends a false-colour ramp of the SDF steps
+ * each pixel took (blue 0, through cyan, green and yellow, to red at 32
+ * and beyond) half and half with the picture, and draws each row's time
+ * (wall time, or CPU time with --balance) as a bar from the left edge
+ * (W/16 for the mean row, clipped at W/4), in alternating colours per
+ * worker band so an unbalanced split shows up as one band's bars
+ * sticking out.  Steps spent on a --cone tile's cone are in the row
+ * time only.
+ */
+static uint32_t heat_ramp[33];
+static uint32_t heat_band[2];
+
+static void init_heat_ramp(SDL_Surface *screen)
+{
+    static const uint8_t stops[5][3] = {
+        { 0, 0, 255 }, { 0, 255, 255 }, { 0, 255, 0 }, { 255, 255, 0 }, { 255, 0, 0 }
+    };
+    for (int i = 0; i <= 32; i++) {
+        int seg = i < 32 ? i / 8 : 3, f = i < 32 ? i % 8 : 8;
+        uint8_t c[3];
+        for (int k = 0; k < 3; k++)
+            c[k] = (uint8_t)(stops[seg][k] + (stops[seg + 1][k] - stops[seg][k]) * f / 8);
+        heat_ramp[i] = SDL_MapRGB(screen->format, c[0], c[1], c[2]);
+    }
+    heat_band[0] = SDL_MapRGB(screen->format, 255, 255, 255);
+    heat_band[1] = SDL_MapRGB(screen->format, 255, 0, 255);
+}
+
+static void heat_overlay(uint32_t *pixels, int pitch4, const frame_params_t *fp,
+                         int nthreads)
+{
+    int W = fp->W, H = fp->H;
+    uint64_t total = 1;
+    for (int y = 0; y < H; y++)
+        total += fp->row_ns[y];
+
+    for (int b = 0; b < nthreads; b++) {
+        for (int y = band_row(fp, b, nthreads); y < band_row(fp, b + 1, nthreads); y++) {
+            uint32_t *dst = pixels + y * pitch4;
+            const uint8_t *ps = fp->pix_steps + (size_t)y * W;
+            for (int x = 0; x < W; x++) {
+                uint32_t h = heat_ramp[ps[x] < 32 ? ps[x] : 32];
+                dst[x] = ((dst[x] >> 1) & 0x7F7F7F7F) + ((h >> 1) & 0x7F7F7F7F);
+            }
+
+            uint64_t len = fp->row_ns[y] * (uint64_t)H * (W / 16) / total;
+            for (int x = 0; x < (int)len && x < W / 4; x++)
+                dst[x] = heat_band[b & 1];
+        }
+    }
+}
+
+/* Write heatmap_NNNN.pgm (steps per pixel, max value = most steps) and
+ * rows_NNNN.csv (row, band, wall time, steps), and print per-band totals */
+static void heat_dump(const frame_params_t *fp, int nthreads, int n)
+{
+    int W = fp->W, H = fp->H;
+    char fname[64];
+    int maxv = 1;
+    for (size_t i = 0; i < (size_t)W * H; i++)
+        if (fp->pix_steps[i] > maxv)
+            maxv = fp->pix_steps[i];
+
+    snprintf(fname, sizeof(fname), "heatmap_%04d.pgm", n);
+    FILE *f = fopen(fname, "wb");
+    if (!f) {
+        perror(fname);
+        return;
+    }
+    fprintf(f, "P5\n%d %d\n%d\n", W, H, maxv);
+    fwrite(fp->pix_steps, 1, (size_t)W * H, f);
+    fclose(f);
+    fprintf(stderr, "Saved %s\n", fname);
+
+    snprintf(fname, sizeof(fname), "rows_%04d.csv", n);
+    f = fopen(fname, "w");
+    if (!f) {
+        perror(fname);
+        return;
+    }
+    fprintf(f, "row,band,us,steps\n");
+    for (int b = 0; b < nthreads; b++) {
+        int rb = band_row(fp, b, nthreads), re = band_row(fp, b + 1, nthreads);
+        double us = 0.0, steps = 0.0;
+        for (int y = rb; y < re; y++) {
+            fprintf(f, "%d,%d,%.1f,%u\n", y, b, fp->row_ns[y] / 1e3,
+                    fp->row_steps[y]);
+            us += fp->row_ns[y] / 1e3;
+            steps += fp->row_steps[y];
+        }
+        fprintf(stderr, "band %2d rows %4d-%4d: %9.1f us, %9.0f steps\n",
+                b, rb, re - 1, us, steps);
+    }
+    fclose(f);
+    fprintf(stderr, "Saved %s\n", fname);
+}
+
+/* Per-band row time (slowest band against the mean) and the time the
+ * workers spend waiting at bar_done, summed over frames */
+typedef struct {
+    double slowest, mean, wait;    /* ns */
+    long   frames;
+} band_stats_t;
+
+static void band_add(band_stats_t *bs, const frame_params_t *fp,
+                     const worker_t *workers, int nthreads, uint64_t released)
+{
+    double total = 0.0, slowest = 0.0, wait = 0.0;
+    for (int b = 0; b < nthreads; b++) {
+        double t = 0.0;
+        for (int y = band_row(fp, b, nthreads); y < band_row(fp, b + 1, nthreads); y++)
+            t += fp->row_ns[y];
+        total += t;
+        if (t > slowest)
+            slowest = t;
+        wait += (double)(released - workers[b].done_ns);
+    }
+    bs->slowest += slowest;
+    bs->mean    += total / nthreads;
+    bs->wait    += wait / nthreads;
+    bs->frames++;
+}
+
+static void band_report(FILE *out, const band_stats_t *bs, const frame_params_t *fp)
+{
+    long n = bs->frames;
+    if (n <= 0 || bs->mean <= 0.0)
+        return;
+    fprintf(out, "row bands (%s): slowest %.2f ms/frame, mean %.2f ms/frame "
+            "(imbalance %.2fx); barrier wait %.2f ms/frame per worker\n",
+            fp->row_clock == CLOCK_MONOTONIC ? "wall time" : "CPU time",
+            bs->slowest / 1e6 / n, bs->mean / 1e6 / n, bs->slowest / bs->mean,
+            bs->wait / 1e6 / n);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [width height]\n"
+        "  --simd      8-wide AVX2 sphere tracer\n"
+        "  --fast-cos  SDF cosines from an interpolated table\n"
+        "  --steps-hist compare steps_left with and without --fast-cos\n"
+        "  --reproject F seed rays at fraction F of last frame's hit distance\n"
+        "  --subsample N trace every Nth pixel first (2 or 4), fill adaptively\n"
+        "  --sub-steps T steps_left threshold for --subsample (default 1)\n"
+        "  --sub-uv T    texel threshold for --subsample (default 4)\n"
+        "  --cone N      cone-march NxN screen tiles before the per-pixel rays\n"
+        "  --cone-stats  with --cone: print steps saved per tile and exit\n"
+        "  --simd-shade  shade rows in a separate AVX2 pass\n"
+        "  --heatmap     steps per pixel and time per row (H overlay, D dump)\n"
+        "  --balance     split rows by last frame's per-row CPU time\n"
+        "  --relax W     over-relaxed sphere tracing, 1 < W < 2\n"
+        "  --steps N     march step budget, 1..255 (default 32)\n"
+        "  --epsilon E   SDF hit threshold (default 0.09402)\n"
+        "  --sweep N     time N frames per budget/threshold setting\n"
+        "  --verify    compare against the scalar kernel and exit\n"
+        "  --bench N   render N frames without a window, print ms/frame\n"
+        "  THREADS env var: thread count (default 16)\n", prog);
+}
+
 int main(int argc, char *argv[])
 {
     int W = 320, H = 200;
-    if (argc >= 3) {
-        W = atoi(argv[1]);
-        H = atoi(argv[2]);
-        if (W <= 0 || H <= 0) {
-            fprintf(stderr,
-                "Usage: %s [width height]\n"
-                "  THREADS env var: thread count (default 16)\n", argv[0]);
+    int simd = 0, verify = 0, bench_frames = 0;
+    int fast_cos = 0, steps_hist = 0;
+    float reproject = 0.0f;
+    int subsample = 0, sub_steps = 1, sub_uv = 4;
+    int cone_n = 0, cone_stats = 0;
+    int simd_shade = 0, heatmap = 0, balance = 0;
+    float relax = 1.0f;
+    int steps = 32, sweep_frames = 0;
+    float eps = EPSILON;
+    const char *pos[2];
+    int npos = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simd") == 0) {
+            simd = 1;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[i], "--fast-cos") == 0) {
+            fast_cos = 1;
+        } else if (strcmp(argv[i], "--steps-hist") == 0) {
+            steps_hist = 1;
+        } else if (strcmp(argv[i], "--reproject") == 0 && i + 1 < argc) {
+            reproject = (float)atof(argv[++i]);
+            if (reproject <= 0.0f || reproject >= 1.0f) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--subsample") == 0 && i + 1 < argc) {
+            subsample = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sub-steps") == 0 && i + 1 < argc) {
+            sub_steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sub-uv") == 0 && i + 1 < argc) {
+            sub_uv = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cone") == 0 && i + 1 < argc) {
+            cone_n = atoi(argv[++i]);
+            if (cone_n < 2) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cone-stats") == 0) {
+            cone_stats = 1;
+        } else if (strcmp(argv[i], "--simd-shade") == 0) {
+            simd_shade = 1;
+        } else if (strcmp(argv[i], "--heatmap") == 0) {
+            heatmap = 1;
+        } else if (strcmp(argv[i], "--balance") == 0) {
+            balance = 1;
+        } else if (strcmp(argv[i], "--relax") == 0 && i + 1 < argc) {
+            relax = (float)atof(argv[++i]);
+            if (!(relax > 1.0f && relax < 2.0f)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc) {
+            eps = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' || npos == 2) {
+            usage(argv[0]);
             return 1;
+        } else {
+            pos[npos++] = argv[i];
         }
     }
+    if (npos == 2) {
+        W = atoi(pos[0]);
+        H = atoi(pos[1]);
+    }
+    if (W <= 0 || H <= 0 || npos == 1 ||
+        (subsample != 0 && subsample != 2 && subsample != 4) ||
+        sub_steps < 0 || sub_uv < 0 ||
+        (simd && (fast_cos || reproject > 0.0f || subsample)) ||
+        (subsample && reproject > 0.0f) ||
+        (cone_n && (simd || subsample || reproject > 0.0f)) ||
+        (cone_stats && !cone_n) || (simd_shade && subsample) ||
+        (relax > 1.0f && (simd || reproject > 0.0f || subsample || cone_n)) ||
+        steps < 1 || steps > MAX_STEPS || !(eps > 0.0f) ||
+        (sweep_frames > 0 && reproject > 0.0f)) {
+        usage(argv[0]);
+        return 1;
+    }
+    set_march(steps, eps);
 
     int nthreads = 16;
     const char *env_threads = getenv("THREADS");
@@ -204,29 +1835,120 @@ int main(int argc, char *argv[])
     }
     if (nthreads > H) nthreads = H;
 
-    fprintf(stderr, "lattice_parallel: %dx%d, %d threads\n", W, H, nthreads);
-
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
+    if (init_ray_table(W, H) < 0) {
+        fprintf(stderr, "Out of memory\n");
         return 1;
     }
 
-    SDL_Surface *screen = SDL_SetVideoMode(W, H, 32,
-                                           SDL_SWSURFACE | SDL_DOUBLEBUF);
-    if (!screen) {
-        fprintf(stderr, "SDL_SetVideoMode: %s\n", SDL_GetError());
-        SDL_Quit();
-        return 1;
+    const char *kernel = "scalar";
+    render_rows_fn render = render_rows_scalar;
+    init_cos_lut();
+    if (fast_cos) {
+        render = render_rows_fast_cos;
+        kernel = "fast-cos";
+    }
+    if (reproject > 0.0f) {
+        render = fast_cos ? render_rows_reproject_fast_cos : render_rows_reproject;
+        kernel = fast_cos ? "reproject+fast-cos" : "reproject";
+    }
+    if (cone_n) {
+        render = fast_cos ? render_rows_cone_fast_cos : render_rows_cone;
+        kernel = fast_cos ? "cone+fast-cos" : "cone";
     }
-    SDL_WM_SetCaption("Lattice", NULL);
+    if (relax > 1.0f) {
+        render = fast_cos ? render_rows_relax_fast_cos : render_rows_relax;
+        kernel = fast_cos ? "relax+fast-cos" : "relax";
+    }
+    if (subsample)
+        kernel = subsample == 2 ? (fast_cos ? "subsample-2+fast-cos" : "subsample-2")
+                                : (fast_cos ? "subsample-4+fast-cos" : "subsample-4");
+#ifdef HAVE_AVX2_KERNEL
+    if (simd) {
+        if (have_avx2()) {
+            render = render_rows_avx2;
+            kernel = "avx2";
+        } else {
+            fprintf(stderr, "lattice_parallel: no AVX2, using scalar kernel\n");
+        }
+    }
+#else
+    (void)simd;
+#endif
+    shade_row_fn shade = NULL;
+    if (simd_shade) {
+        shade = shade_row_scalar;
+#ifdef HAVE_AVX2_KERNEL
+        if (have_avx2())
+            shade = shade_row_avx2;
+#endif
+        if (shade == shade_row_scalar)
+            fprintf(stderr, "lattice_parallel: no AVX2, using scalar shading\n");
+    }
+    fprintf(stderr, "lattice_parallel: %dx%d, %d threads, %s kernel%s\n",
+            W, H, nthreads, kernel,
+            shade == NULL ? "" : shade == shade_row_scalar ? ", row shading"
+                                                           : ", avx2 shading");
 
-    init_palette(screen);
     init_texture();
+    if (steps_hist)
+        return steps_hist_mode(W, H);
+
+    reproj_t rp_state, *rp = NULL;
+    if (reproject > 0.0f) {
+        if (reproj_alloc(&rp_state, W, H, reproject) < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        rp = &rp_state;
+    }
+    subsample_t sub_state, *sub = NULL;
+    if (subsample) {
+        if (sub_alloc(&sub_state, W, H, subsample, sub_steps, sub_uv,
+                      fast_cos) < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        sub = &sub_state;
+    }
+    cone_t cone_state, *cone = NULL;
+    if (cone_n) {
+        if (cone_alloc(&cone_state, W, H, cone_n) < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        cone = &cone_state;
+        if (cone_stats) {
+            int rc = cone_stats_mode(render, W, H, cone);
+            free(cone->tile_steps);
+            return rc;
+        }
+    }
+    if (verify) {
+        int rc = verify_mode(render, kernel, W, H, rp, sub, cone, shade,
+                             relax);
+        if (rp)
+            reproj_free(rp);
+        if (sub)
+            sub_free(sub);
+        if (cone)
+            free(cone->tile_steps);
+        return rc;
+    }
 
-    uint8_t *pixbuf = (uint8_t *)malloc((size_t)W * H);
-    if (!pixbuf) {
+    uint8_t  *pixbuf    = (uint8_t *)malloc((size_t)W * H);
+    uint32_t *row_steps = (uint32_t *)calloc(H, sizeof(uint32_t));
+    uint8_t  *pix_steps = NULL;
+    uint64_t *row_ns    = NULL;
+    int      *row_split = NULL;
+    if (heatmap)
+        pix_steps = (uint8_t *)calloc((size_t)W * H, 1);
+    if (heatmap || balance)
+        row_ns = (uint64_t *)calloc(H, sizeof(uint64_t));
+    if (balance)
+        row_split = (int *)malloc(sizeof(int) * (nthreads + 1));
+    if (!pixbuf || !row_steps || (heatmap && !pix_steps) ||
+        ((heatmap || balance) && !row_ns) || (balance && !row_split)) {
         fprintf(stderr, "Out of memory\n");
-        SDL_Quit();
         return 1;
     }
 
@@ -234,12 +1956,30 @@ int main(int argc, char *argv[])
     frame_params_t fp = {
         .W = W, .H = H,
         .pixbuf = pixbuf,
+        .row_steps = row_steps,
+        .pix_steps = pix_steps,
+        .row_ns = row_ns,
+        .row_clock = balance ? CLOCK_THREAD_CPUTIME_ID : CLOCK_MONOTONIC,
+        .row_split = row_split,
+        .rp = rp,
+        .sub = sub,
+        .cone = cone,
+        .shade = shade,
+        .relax = relax,
         .quit = 0
     };
+    double steps_total = 0.0, rejected_total = 0.0;
+    long   frames_total = 0;
+    traced_stats_t traced = { 0 };
+    band_stats_t   bands = { 0 };
+    if (row_split)
+        for (int b = 0; b <= nthreads; b++)
+            row_split[b] = b * H / nthreads;
 
     /* Create barriers: nthreads workers + 1 main thread */
-    pthread_barrier_t bar_start, bar_done;
+    pthread_barrier_t bar_start, bar_mid, bar_done;
     pthread_barrier_init(&bar_start, NULL, nthreads + 1);
+    pthread_barrier_init(&bar_mid,   NULL, nthreads);
     pthread_barrier_init(&bar_done,  NULL, nthreads + 1);
 
     /* Spawn worker threads */
@@ -250,16 +1990,88 @@ int main(int argc, char *argv[])
         workers[i].id        = i;
         workers[i].nthreads  = nthreads;
         workers[i].fp        = &fp;
+        workers[i].render    = render;
         workers[i].bar_start = &bar_start;
+        workers[i].bar_mid   = &bar_mid;
         workers[i].bar_done  = &bar_done;
         pthread_create(&threads[i], NULL, worker_func, &workers[i]);
     }
 
-    float zmove_f = (float)ZMOVE_INIT;
+    SDL_Surface *screen = NULL;
+    int running = 1, sweep_rc = 0;
+
+    if (sweep_frames > 0) {
+        sweep_rc = sweep_mode(&fp, kernel, nthreads, sweep_frames,
+                              &bar_start, &bar_done);
+        running = 0;
+    } else if (bench_frames > 0) {
+        /* --bench: render frames at speed 1 without a window; with
+         * --balance, first with the static split for comparison */
+        for (int pass = balance ? 0 : 1; pass < 2; pass++) {
+            double zmove = ZMOVE_INIT;
+            struct timespec t0, t1;
+
+            steps_total = rejected_total = 0.0;
+            frames_total = 0;
+            traced = (traced_stats_t){ 0 };
+            bands = (band_stats_t){ 0 };
+            fp.row_split = pass ? row_split : NULL;
+            if (rp)
+                rp->have_prev = 0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+
+            for (int f = 0; f < bench_frames; f++) {
+                zmove -= 1.0;
+                camera_state(&fp, zmove);
+                if (rp)
+                    reproject_seeds(rp, &fp, zmove);
+                render_pool_frame(&bar_start, &bar_done);
+                uint64_t released = now_ns(CLOCK_MONOTONIC);
+                steps_total += sum_rows(row_steps, H);
+                if (rp)
+                    rejected_total += sum_rows(rp->row_rejected, H);
+                if (sub)
+                    traced_add(&traced, sub, W, H);
+                if (row_ns)
+                    band_add(&bands, &fp, workers, nthreads, released);
+                if (fp.row_split)
+                    balance_rows(&fp, nthreads);
+                frames_total++;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+            printf("bench %dx%d, %s kernel, %d threads%s: %d frames, %.2f ms/frame, "
+                   "%.1f Mpixel/s\n", W, H, kernel, nthreads,
+                   !balance ? "" : pass ? ", balanced split" : ", static split",
+                   bench_frames, ms / bench_frames,
+                   (double)W * H * bench_frames / (ms * 1e3));
+            report_steps(stdout, steps_total, rejected_total, frames_total, W, H, rp);
+            traced_report(stdout, &traced);
+            if (row_ns)
+                band_report(stdout, &bands, &fp);
+        }
+        running = 0;
+    } else if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
+        running = 0;
+    } else {
+        screen = SDL_SetVideoMode(W, H, 32, SDL_SWSURFACE | SDL_DOUBLEBUF);
+        if (!screen) {
+            fprintf(stderr, "SDL_SetVideoMode: %s\n", SDL_GetError());
+            running = 0;
+        } else {
+            SDL_WM_SetCaption("Lattice", NULL);
+            init_palette(screen);
+            init_heat_ramp(screen);
+        }
+    }
+
+    double zmove = ZMOVE_INIT;
     float speed_mult = 1.0f;
     int   screenshot_counter = 0;
     int   take_screenshot = 0;
-    int   running = 1;
+    int   show_heat = heatmap, take_dump = 0, dump_counter = 0;
 
     while (running) {
         uint32_t frame_start = SDL_GetTicks();
@@ -282,24 +2094,42 @@ int main(int argc, char *argv[])
                 case SDLK_s:
                     take_screenshot = 1;
                     break;
+                case SDLK_h:
+                    show_heat = heatmap && !show_heat;
+                    break;
+                case SDLK_d:
+                    take_dump = heatmap;
+                    break;
                 default: break;
                 }
             }
         }
 
-        zmove_f -= speed_mult;
-        float angle = zmove_f / 41.0f;
+        /* Dump the frame on screen, before the workers overwrite it */
+        if (take_dump && frames_total > 0) {
+            heat_dump(&fp, nthreads, ++dump_counter);
+            take_dump = 0;
+        }
+
+        zmove -= speed_mult;
 
         /* Set frame params (workers are idle, waiting on bar_start) */
-        fp.cosa  = cosf(angle);
-        fp.sina  = sinf(angle);
-        fp.cam_z = zmove_f / (float)M_PI;
-
-        /* Release workers */
-        pthread_barrier_wait(&bar_start);
+        camera_state(&fp, zmove);
+        if (row_split)
+            balance_rows(&fp, nthreads);
+        if (rp)
+            reproject_seeds(rp, &fp, zmove);
 
-        /* Wait for all workers to finish rendering */
-        pthread_barrier_wait(&bar_done);
+        render_pool_frame(&bar_start, &bar_done);
+        uint64_t released = now_ns(CLOCK_MONOTONIC);
+        steps_total += sum_rows(row_steps, H);
+        if (rp)
+            rejected_total += sum_rows(rp->row_rejected, H);
+        if (sub)
+            traced_add(&traced, sub, W, H);
+        if (row_ns)
+            band_add(&bands, &fp, workers, nthreads, released);
+        frames_total++;
 
         /* Blit to screen */
         if (SDL_MUSTLOCK(screen))
@@ -314,6 +2144,8 @@ int main(int argc, char *argv[])
             for (int x = 0; x < W; x++)
                 dst[x] = palette[src[x]];
         }
+        if (show_heat)
+            heat_overlay(pixels, pitch4, &fp, nthreads);
 
         if (SDL_MUSTLOCK(screen))
             SDL_UnlockSurface(screen);
@@ -342,10 +2174,30 @@ int main(int argc, char *argv[])
         pthread_join(threads[i], NULL);
 
     pthread_barrier_destroy(&bar_start);
+    pthread_barrier_destroy(&bar_mid);
     pthread_barrier_destroy(&bar_done);
     free(threads);
     free(workers);
+    if (bench_frames <= 0 && screen) {
+        report_steps(stderr, steps_total, rejected_total, frames_total, W, H, rp);
+        traced_report(stderr, &traced);
+        if (row_ns)
+            band_report(stderr, &bands, &fp);
+    }
+    if (rp)
+        reproj_free(rp);
+    if (sub)
+        sub_free(sub);
+    if (cone)
+        free(cone->tile_steps);
+    free(row_split);
+    free(row_ns);
+    free(pix_steps);
+    free(row_steps);
     free(pixbuf);
-    SDL_Quit();
-    return 0;
+    if (bench_frames <= 0 && sweep_frames <= 0)
+        SDL_Quit();
+    if (sweep_frames > 0)
+        return sweep_rc;
+    return screen || bench_frames > 0 ? 0 : 1;
 }